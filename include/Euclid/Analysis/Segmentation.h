@@ -7,10 +7,35 @@
  */
 #pragma once
 
+#include <vector>
+
 namespace Euclid
 {
 /** @{*/
 
+/** Linear solvers of random walk segmentation.
+ *
+ *  The probabilities of reaching each seed are the solutions of a sparse
+ *  linear system, one right-hand side per seed, which are solved in blocks
+ *  in parallel. The direct solvers factorize the system once, which is fast
+ *  for meshes up to a few hundred thousand faces, while the iterative
+ *  solvers use much less memory on larger ones.
+ *  The symmetric solvers use the graph laplacian with the weights of both
+ *  directions of an edge averaged, which slightly differs from the original
+ *  formulation where the weights are asymmetric.
+ */
+enum class RandomWalkSolver
+{
+	/** Sparse LU of the original system.*/
+	sparse_lu,
+	/** Sparse LDLT of the symmetric system.*/
+	ldlt,
+	/** Conjugate gradient of the symmetric system.*/
+	conjugate_gradient,
+	/** BiCGSTAB of the original system.*/
+	bicgstab
+};
+
 /** Mesh segmentation using random walk.
  *
  *  #### Reference
@@ -22,7 +47,8 @@ template<typename Mesh>
 void random_walk_segmentation(
 	const Mesh& mesh,
 	std::vector<int>& seed_indices,
-	std::vector<int>& face_class);
+	std::vector<int>& face_class,
+	RandomWalkSolver solver = RandomWalkSolver::sparse_lu);
 
 
 /** Point set segmentation using random walk.
@@ -39,7 +65,8 @@ void random_walk_segmentation(
 	PPMap point_pmap,
 	NPMap normal_pmap,
 	std::vector<int>& seed_indices,
-	std::vector<int>& point_class);
+	std::vector<int>& point_class,
+	RandomWalkSolver solver = RandomWalkSolver::sparse_lu);
 
 /** @}*/
 } // namespace Euclid
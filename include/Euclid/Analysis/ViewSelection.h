@@ -10,6 +10,7 @@
  */
 #pragma once
 
+#include <utility>
 #include <vector>
 #include <CGAL/boost/graph/properties.h>
 
@@ -37,6 +38,9 @@ public:
      *  number of samples, but rather use the number of iterations of
      *  subdivision to control the coarseness of the sphere.
      *
+     *  The unit icosphere is generated only once for each number of
+     *  iterations and then scaled and translated to fit the mesh.
+     *
      *  @param mesh The target mesh object.
      *  @param scale The scale of the view sphere's radius, by 1.0 the sphere
      *  equals to the minimum bounding sphere of the mesh.
@@ -52,6 +56,10 @@ public:
      *  desired number of sample points, but the triangulated sphere is not
      *  as regular as a subdivision sphere.
      *
+     *  The random points are drawn and triangulated only once for each number
+     *  of samples, all view spheres with the same number of samples share the
+     *  same unit sphere which is scaled and translated to fit the mesh.
+     *
      *  @param mesh The target mesh object.
      *  @param scale The scale of the view sphere's radius, by 1.0 the sphere
      *  equals to the minimum bounding sphere of the mesh.
@@ -61,6 +69,24 @@ public:
                                         float scale = 3.0f,
                                         int samples = 1000);
 
+    /** Build a view sphere using a spherical Fibonacci lattice.
+     *
+     *  The Fibonacci lattice places any desired number of sample points
+     *  nearly evenly on the sphere, which gives a more regular triangulation
+     *  than make_random() without its clustering artifacts.
+     *
+     *  The lattice is triangulated only once for each number of samples and
+     *  then scaled and translated to fit the mesh.
+     *
+     *  @param mesh The target mesh object.
+     *  @param scale The scale of the view sphere's radius, by 1.0 the sphere
+     *  equals to the minimum bounding sphere of the mesh.
+     *  @param samples The number of sample points.
+     */
+    static ViewSphere<Mesh> make_fibonacci(const Mesh& mesh,
+                                           float scale = 3.0f,
+                                           int samples = 1000);
+
 public:
     Mesh mesh;
     Point_3 center;
@@ -89,7 +115,100 @@ void proxy_view_selection(const Mesh& mesh,
                           std::vector<T>& view_scores,
                           float weight = 0.5f);
 
+/** Measures of view quality based on visibility.
+ *
+ *  @sa visibility_view_selection()
+ */
+enum class ViewMeasure
+{
+    /** The ratio of the surface area of the visible faces to the total
+     *  surface area.
+     */
+    visible_area,
+    /** The viewpoint entropy of the relative projected areas of the visible
+     *  faces and the background.
+     */
+    viewpoint_entropy
+};
+
+/** View selection using exact visibility.
+ *
+ *  Render a face index image of the mesh from every vertex of the view
+ *  sphere looking at the center of the sphere, and measure the view quality
+ *  from the visible faces. Views are rendered in parallel against one shared
+ *  scene.
+ *
+ *  @param mesh The target mesh model.
+ *  @param view_sphere The viewing sphere.
+ *  @param view_scores The corresponding view scores.
+ *  @param measure The measure of view quality.
+ *  @param resolution Width and height of the rendered images.
+ *
+ *  #### Reference
+ *  Vázquez P P, Feixas M, Sbert M, et al.
+ *  Viewpoint selection using viewpoint entropy[C].
+ *  Vision, Modeling, and Visualization, 2001: 273-280.
+ */
+template<typename Mesh, typename T>
+void visibility_view_selection(
+    const Mesh& mesh,
+    const ViewSphere<Mesh>& view_sphere,
+    std::vector<T>& view_scores,
+    ViewMeasure measure = ViewMeasure::viewpoint_entropy,
+    int resolution = 128);
+
+/** View selection using exact visibility on a subset of views.
+ *
+ *  Same as above, but only the vertices of the view sphere indexed by views
+ *  are evaluated, view_scores[i] is the score of views[i].
+ */
+template<typename Mesh, typename T>
+void visibility_view_selection(
+    const Mesh& mesh,
+    const ViewSphere<Mesh>& view_sphere,
+    const std::vector<int>& views,
+    std::vector<T>& view_scores,
+    ViewMeasure measure = ViewMeasure::viewpoint_entropy,
+    int resolution = 128);
+
+/** Search for the best view using exact visibility.
+ *
+ *  Instead of scoring every vertex of a dense view sphere, this function
+ *  scores a coarse icosphere around the mesh, keeps the top_k views and only
+ *  scores the neighborhoods of them on the next finer icosphere, until the
+ *  spacing of the views falls below the tolerance. Each level is scored in
+ *  parallel and views are never scored twice.
+ *
+ *  The search is greedy, the result is never worse than the best view of the
+ *  coarse icosphere, but it may miss the best view of the finest level when
+ *  that lies away from the top_k neighborhoods. Larger top_k trades speed for
+ *  a closer result.
+ *
+ *  @param mesh The target mesh model.
+ *  @param scale The scale of the view sphere's radius, by 1.0 the sphere
+ *  equals to the minimum bounding sphere of the mesh.
+ *  @param measure The measure of view quality.
+ *  @param tolerance The angular spacing of views at the finest level, in
+ *  degrees.
+ *  @param top_k Number of views whose neighborhoods are refined per level.
+ *  @param resolution Width and height of the rendered images.
+ *  @return The best viewpoint and its score.
+ *
+ *  @sa visibility_view_selection()
+ */
+template<typename Mesh>
+std::pair<typename ViewSphere<Mesh>::Point_3, float> best_view(
+    const Mesh& mesh,
+    float scale = 3.0f,
+    ViewMeasure measure = ViewMeasure::viewpoint_entropy,
+    float tolerance = 1.0f,
+    int top_k = 4,
+    int resolution = 128);
+
 /** @}*/
 } // namespace Euclid
 
+#include "src/ViewSphere.cpp"
 #include "src/ProxyViewSelection.cpp"
+#include "src/VisibilityViewSelection.cpp"
+#include "src/BestView.cpp"
@@ -0,0 +1,108 @@
+/** Surface visibility.
+ *
+ *  This package contains functions to compute how much of the surrounding
+ *  space each part of a surface could see, by tracing rays with Embree.
+ *
+ *  Ambient occlusion is the cosine weighted ratio of the hemisphere above a
+ *  point which is blocked by the mesh within a maximum distance. With an
+ *  infinite distance, one minus the occlusion is the sky visibility of the
+ *  point.
+ *
+ *  The shape diameter casts the rays inward instead, and measures the local
+ *  thickness of the shape.
+ *
+ *  @defgroup PkgVisibility Visibility
+ *  @ingroup PkgAnalysis
+ */
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <CGAL/boost/graph/properties.h>
+
+namespace Euclid
+{
+/** @{*/
+
+/** Ambient occlusion of the vertices of a mesh.
+ *
+ *  For each vertex, rays are cast in cosine weighted directions over the
+ *  hemisphere around the vertex normal. The samples of a vertex are
+ *  stratified and only depend on the seed and the vertex index, so results
+ *  do not depend on the number of threads.
+ *
+ *  @param mesh Input mesh.
+ *  @param vnmap The vertex normal property map.
+ *  @param occlusion Output occlusion of each vertex in range [0, 1], ordered
+ *  like vertices(mesh), 0 means fully visible.
+ *  @param samples Number of rays per vertex.
+ *  @param max_distance Occluders further than this distance are ignored.
+ *  @param seed Seed of the sample patterns.
+ */
+template<typename Mesh, typename VertexNormalMap, typename T>
+void vertex_ambient_occlusion(
+    const Mesh& mesh,
+    const VertexNormalMap& vnmap,
+    std::vector<T>& occlusion,
+    int samples = 64,
+    float max_distance = std::numeric_limits<float>::infinity(),
+    unsigned seed = 0);
+
+/** Ambient occlusion of the faces of a mesh.
+ *
+ *  Same as vertex_ambient_occlusion(), but the rays start from the face
+ *  centroids around the face normals.
+ *
+ *  @param mesh Input triangle mesh.
+ *  @param occlusion Output occlusion of each face in range [0, 1], ordered
+ *  like faces(mesh), 0 means fully visible.
+ *  @param samples Number of rays per face.
+ *  @param max_distance Occluders further than this distance are ignored.
+ *  @param seed Seed of the sample patterns.
+ */
+template<typename Mesh, typename T>
+void face_ambient_occlusion(
+    const Mesh& mesh,
+    std::vector<T>& occlusion,
+    int samples = 64,
+    float max_distance = std::numeric_limits<float>::infinity(),
+    unsigned seed = 0);
+
+/** The shape diameter function.
+ *
+ *  The shape diameter function measures the local thickness of a shape. For
+ *  each face, rays are cast from its centroid in a cone around the inward
+ *  normal, rays further than one standard deviation from the median hit
+ *  distance are discarded, and the remaining distances are averaged with
+ *  weights inversely proportional to the angle from the cone axis.
+ *
+ *  @param mesh Input triangle mesh, with consistently outward oriented
+ *  faces.
+ *  @param sdf The output shape diameter of each face, ordered like
+ *  faces(mesh). Faces without any valid hit get 0.
+ *  @param cone_angle Opening angle of the cone in degrees.
+ *  @param rays Number of rays per face.
+ *  @param smooth_iterations Number of iterations to average the values of
+ *  each face with its edge-adjacent faces.
+ *  @param seed Seed of the sample patterns.
+ *
+ *  #### Reference
+ *  Shapira L, Shamir A, Cohen-Or D.
+ *  Consistent mesh partitioning and skeletonisation using the shape diameter
+ *  function[J].
+ *  The Visual Computer, 2008, 24(4): 249-259.
+ */
+template<typename Mesh, typename T>
+void shape_diameter_function(const Mesh& mesh,
+                             std::vector<T>& sdf,
+                             float cone_angle = 120.0f,
+                             int rays = 30,
+                             int smooth_iterations = 0,
+                             unsigned seed = 0);
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/AmbientOcclusion.cpp"
+#include "src/ShapeDiameter.cpp"
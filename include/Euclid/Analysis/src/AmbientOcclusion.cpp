@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+#include <Euclid/Geometry/MeshHelpers.h>
+#include <Euclid/Math/Vector.h>
+#include <Euclid/Render/RayTracer.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Offset of the ray origins to avoid self intersections, relative to the
+// size of the mesh
+inline float _ray_epsilon(const std::vector<float>& positions)
+{
+    Eigen::Map<const Eigen::Matrix3Xf> points(positions.data(),
+                                              3,
+                                              positions.size() / 3);
+    auto diagonal =
+        (points.rowwise().maxCoeff() - points.rowwise().minCoeff()).norm();
+    return 1e-4f * diagonal;
+}
+
+// Centroids and unit normals of the faces
+inline void _face_frames(const std::vector<float>& positions,
+                         const std::vector<unsigned>& indices,
+                         std::vector<Eigen::Vector3f>& centroids,
+                         std::vector<Eigen::Vector3f>& normals)
+{
+    const auto n_faces = indices.size() / 3;
+    centroids.resize(n_faces);
+    normals.resize(n_faces);
+    for (size_t i = 0; i < n_faces; ++i) {
+        Eigen::Map<const Eigen::Vector3f> p0(&positions[3 * indices[3 * i]]);
+        Eigen::Map<const Eigen::Vector3f> p1(
+            &positions[3 * indices[3 * i + 1]]);
+        Eigen::Map<const Eigen::Vector3f> p2(
+            &positions[3 * indices[3 * i + 2]]);
+        centroids[i] = (p0 + p1 + p2) / 3.0f;
+        normals[i] = (p1 - p0).cross(p2 - p0).normalized();
+    }
+}
+
+// Trace the occlusion rays of each point in packets, points are processed in
+// parallel
+template<typename T>
+void _ambient_occlusion(RTCScene scene,
+                        const std::vector<Eigen::Vector3f>& origins,
+                        const std::vector<Eigen::Vector3f>& normals,
+                        std::vector<T>& occlusion,
+                        int samples,
+                        float max_distance,
+                        float epsilon,
+                        unsigned seed)
+{
+    if (samples <= 0) {
+        throw std::invalid_argument("Number of samples must be positive.");
+    }
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    const int n = static_cast<int>(origins.size());
+    occlusion.resize(n);
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < n; ++i) {
+        const Eigen::Vector3f normal = normals[i].normalized();
+        auto hits = 0;
+        for (int first = 0; first < samples; first += 8) {
+            alignas(32) int valid[8];
+            RTCRay8 rays;
+            for (int j = 0; j < 8; ++j) {
+                const int k = first + j;
+                valid[j] = k < samples ? -1 : 0;
+                float s = 0.0f, t = 0.0f;
+                if (k < samples) {
+                    _stratified_sample(seed, i, k, samples, s, t);
+                }
+                auto dir = _cosine_hemisphere(normal, s, t);
+                rays.org_x[j] = origins[i](0);
+                rays.org_y[j] = origins[i](1);
+                rays.org_z[j] = origins[i](2);
+                rays.dir_x[j] = dir(0);
+                rays.dir_y[j] = dir(1);
+                rays.dir_z[j] = dir(2);
+                rays.tnear[j] = epsilon;
+                rays.tfar[j] = max_distance;
+                rays.time[j] = 0.0f;
+                rays.mask[j] = 0xFFFFFFFF;
+                rays.id[j] = j;
+                rays.flags[j] = 0;
+            }
+            rtcOccluded8(valid, scene, &context, &rays);
+            for (int j = 0; j < 8; ++j) {
+                // tfar is set to -inf for occluded rays
+                if (valid[j] != 0 && rays.tfar[j] < 0.0f) { ++hits; }
+            }
+        }
+        occlusion[i] = static_cast<T>(static_cast<float>(hits) / samples);
+    }
+}
+
+} // namespace _impl
+
+template<typename Mesh, typename VertexNormalMap, typename T>
+void vertex_ambient_occlusion(const Mesh& mesh,
+                              const VertexNormalMap& vnmap,
+                              std::vector<T>& occlusion,
+                              int samples,
+                              float max_distance,
+                              unsigned seed)
+{
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    extract_mesh<3>(mesh, positions, indices);
+
+    std::vector<Eigen::Vector3f> origins;
+    std::vector<Eigen::Vector3f> normals;
+    origins.reserve(num_vertices(mesh));
+    normals.reserve(num_vertices(mesh));
+    auto vpmap = get(boost::vertex_point, mesh);
+    for (auto v : vertices(mesh)) {
+        origins.push_back(cgal_to_eigen<float>(get(vpmap, v)));
+        normals.push_back(cgal_to_eigen<float>(get(vnmap, v)));
+    }
+
+    RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+    _impl::_ambient_occlusion(raytracer.scene(),
+                              origins,
+                              normals,
+                              occlusion,
+                              samples,
+                              max_distance,
+                              _impl::_ray_epsilon(positions),
+                              seed);
+}
+
+template<typename Mesh, typename T>
+void face_ambient_occlusion(const Mesh& mesh,
+                            std::vector<T>& occlusion,
+                            int samples,
+                            float max_distance,
+                            unsigned seed)
+{
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    extract_mesh<3>(mesh, positions, indices);
+
+    std::vector<Eigen::Vector3f> origins;
+    std::vector<Eigen::Vector3f> normals;
+    _impl::_face_frames(positions, indices, origins, normals);
+
+    RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+    _impl::_ambient_occlusion(raytracer.scene(),
+                              origins,
+                              normals,
+                              occlusion,
+                              samples,
+                              max_distance,
+                              _impl::_ray_epsilon(positions),
+                              seed);
+}
+
+} // namespace Euclid
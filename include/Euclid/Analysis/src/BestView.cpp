@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <Eigen/Dense>
+#include <Euclid/Geometry/PrimitiveGenerator.h>
+#include <Euclid/Math/Vector.h>
+#include <Euclid/Render/RayTracer.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// A unit icosphere and its vertex adjacency in compressed rows
+struct _IcosphereLevel
+{
+    std::vector<float> positions;
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+};
+
+// Return the shared icosphere of the subdivision level, which is generated on
+// first request
+inline std::shared_ptr<const _IcosphereLevel> _icosphere_level(int level)
+{
+    static std::mutex mutex;
+    static std::map<int, std::shared_ptr<const _IcosphereLevel>> levels;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& icosphere = levels[level];
+    if (!icosphere) {
+        auto result = std::make_shared<_IcosphereLevel>();
+        std::vector<int> indices;
+        make_icosphere(result->positions, indices, level);
+
+        // Every directed edge of a closed, consistently oriented mesh
+        // appears exactly once, so this visits each neighbor once
+        auto n = result->positions.size() / 3;
+        result->offsets.assign(n + 1, 0);
+        for (auto v : indices) {
+            ++result->offsets[v + 1];
+        }
+        for (size_t i = 0; i < n; ++i) {
+            result->offsets[i + 1] += result->offsets[i];
+        }
+        result->neighbors.resize(indices.size());
+        auto fill = result->offsets;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (size_t j = 0; j < 3; ++j) {
+                auto v = indices[i + j];
+                result->neighbors[fill[v]++] = indices[i + (j + 1) % 3];
+            }
+        }
+        icosphere = std::move(result);
+    }
+    return icosphere;
+}
+
+} // namespace _impl
+
+template<typename Mesh>
+std::pair<typename ViewSphere<Mesh>::Point_3, float> best_view(
+    const Mesh& mesh,
+    float scale,
+    ViewMeasure measure,
+    float tolerance,
+    int top_k,
+    int resolution)
+{
+    using Point_3 = typename ViewSphere<Mesh>::Point_3;
+    using FT = typename ViewSphere<Mesh>::FT;
+    const int coarse_level = 1;
+    const int max_level = 7;
+    // Angle between two adjacent vertices of an icosahedron
+    const auto edge_angle = std::acos(1.0 / std::sqrt(5.0)) * 180.0 / M_PI;
+
+    if (tolerance <= 0.0f) {
+        throw std::invalid_argument("Tolerance must be positive.");
+    }
+    if (top_k < 1) {
+        throw std::invalid_argument("top_k must be at least 1.");
+    }
+
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    std::vector<float> face_areas;
+    _impl::_visibility_setup(mesh, positions, indices, face_areas);
+    RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+
+    Point_3 center;
+    FT radius;
+    _impl::_bounding_sphere(mesh, center, radius);
+    Eigen::Vector3f ecenter = cgal_to_eigen<float>(center);
+    auto view_radius = static_cast<float>(radius) * scale;
+
+    auto finest = coarse_level;
+    while (finest < max_level && edge_angle / (1 << finest) > tolerance) {
+        ++finest;
+    }
+    // Vertices of coarser levels are a prefix of the finest level
+    auto sphere = _impl::_icosphere_level(finest);
+    auto viewpoint = [&](int v) {
+        Eigen::Map<const Eigen::Vector3f> dir(&sphere->positions[3 * v]);
+        return Eigen::Vector3f(ecenter + view_radius * dir);
+    };
+
+    // Score views that are not evaluated yet
+    std::unordered_map<int, float> scores;
+    auto evaluate = [&](const std::vector<int>& candidates) {
+        std::vector<int> views;
+        std::vector<Eigen::Vector3f> viewpoints;
+        for (auto v : candidates) {
+            if (scores.find(v) == scores.end()) {
+                views.push_back(v);
+                viewpoints.push_back(viewpoint(v));
+            }
+        }
+        std::vector<float> view_scores;
+        _impl::_visibility_scores(raytracer,
+                                  face_areas,
+                                  viewpoints,
+                                  ecenter,
+                                  static_cast<float>(radius),
+                                  measure,
+                                  resolution,
+                                  view_scores);
+        for (size_t i = 0; i < views.size(); ++i) {
+            scores.emplace(views[i], view_scores[i]);
+        }
+    };
+
+    // Score the whole coarse level, then refine around the best views
+    auto coarse = _impl::_icosphere_level(coarse_level);
+    std::vector<int> candidates(coarse->positions.size() / 3);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        candidates[i] = static_cast<int>(i);
+    }
+    std::vector<std::pair<float, int>> ranking;
+    for (auto level = coarse_level;; ++level) {
+        evaluate(candidates);
+
+        ranking.clear();
+        for (const auto& [v, score] : scores) {
+            ranking.emplace_back(score, v);
+        }
+        auto k = std::min(static_cast<size_t>(top_k), ranking.size());
+        std::partial_sort(ranking.begin(),
+                          ranking.begin() + k,
+                          ranking.end(),
+                          [](const auto& lhs, const auto& rhs) {
+                              return lhs.first > rhs.first ||
+                                     (lhs.first == rhs.first &&
+                                      lhs.second < rhs.second);
+                          });
+        if (level == finest) { break; }
+
+        auto next = _impl::_icosphere_level(level + 1);
+        candidates.clear();
+        for (size_t i = 0; i < k; ++i) {
+            auto v = ranking[i].second;
+            candidates.push_back(v);
+            for (auto j = next->offsets[v]; j < next->offsets[v + 1]; ++j) {
+                candidates.push_back(next->neighbors[j]);
+            }
+        }
+    }
+
+    auto best = viewpoint(ranking.front().second);
+    return std::make_pair(eigen_to_cgal<Point_3>(best), ranking.front().first);
+}
+
+} // namespace Euclid
@@ -3,80 +3,15 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 
-#include <CGAL/Min_sphere_of_spheres_d.h>
-#include <CGAL/point_generators_3.h>
-#include <CGAL/convex_hull_3.h>
 #include <Euclid/Analysis/OBB.h>
 #include <Euclid/Geometry/MeshHelpers.h>
 #include <Euclid/Geometry/MeshProperties.h>
-#include <Euclid/Geometry/PrimitiveGenerator.h>
 #include <Euclid/Math/Vector.h>
-#include <Euclid/Render/RayTracer.h>
+#include <Euclid/Render/Rasterizer.h>
 
 namespace Euclid
 {
 
-template<typename Mesh>
-ViewSphere<Mesh> ViewSphere<Mesh>::make_subdiv(const Mesh& mesh,
-                                               float scale,
-                                               int subdiv)
-{
-    using MSTraits = CGAL::Min_sphere_of_spheres_d_traits_3<Kernel, FT>;
-    using Min_sphere = CGAL::Min_sphere_of_spheres_d<MSTraits>;
-    using Sphere = typename Min_sphere::Sphere;
-
-    auto mesh_vpmap = get(boost::vertex_point, mesh);
-    std::vector<Sphere> spheres;
-    spheres.reserve(num_vertices(mesh));
-    for (const auto& v : vertices(mesh)) {
-        spheres.emplace_back(mesh_vpmap[v], 0.0f);
-    }
-    Min_sphere ms(spheres.begin(), spheres.end());
-
-    ViewSphere<Mesh> result;
-    result.radius = ms.radius() * scale;
-    auto iter = ms.center_cartesian_begin();
-    result.center = Point_3(*iter, *(iter + 1), *(iter + 2));
-
-    Euclid::make_subdivision_sphere(
-        result.mesh, result.center, result.radius, subdiv);
-
-    return result;
-}
-
-template<typename Mesh>
-ViewSphere<Mesh> ViewSphere<Mesh>::make_random(const Mesh& mesh,
-                                               float scale,
-                                               int samples)
-{
-    using MSTraits = CGAL::Min_sphere_of_spheres_d_traits_3<Kernel, FT>;
-    using Min_sphere = CGAL::Min_sphere_of_spheres_d<MSTraits>;
-    using Sphere = typename Min_sphere::Sphere;
-
-    auto mesh_vpmap = get(boost::vertex_point, mesh);
-    std::vector<Sphere> spheres;
-    spheres.reserve(num_vertices(mesh));
-    for (const auto& v : vertices(mesh)) {
-        spheres.emplace_back(mesh_vpmap[v], 0.0f);
-    }
-    Min_sphere ms(spheres.begin(), spheres.end());
-
-    ViewSphere<Mesh> result;
-    result.radius = ms.radius() * scale;
-    auto iter = ms.center_cartesian_begin();
-    result.center = Point_3(*iter, *(iter + 1), *(iter + 2));
-
-    auto generator = CGAL::Random_points_on_sphere_3<Point_3>(result.radius);
-    std::vector<Point_3> points(samples);
-    std::copy_n(generator, samples, points.begin());
-    for (auto& p : points) {
-        p = p + (result.center - CGAL::ORIGIN);
-    }
-    CGAL::convex_hull_3(points.begin(), points.end(), result.mesh);
-
-    return result;
-}
-
 template<typename Mesh, typename T>
 void proxy_view_selection(const Mesh& mesh,
                           const ViewSphere<Mesh>& view_sphere,
@@ -98,13 +33,13 @@ void proxy_view_selection(const Mesh& mesh,
     auto mesh_vpmap = get(boost::vertex_point, mesh);
     OBB<Kernel> obb(vbeg, vend, mesh_vpmap);
 
-    // Compute projected area
+    // Compute projected area, each view is only rendered once so rasterizing
+    // is cheaper than building a BVH
     std::vector<float> positions;
     std::vector<unsigned> indices;
     extract_mesh<3>(mesh, positions, indices);
-    positions.push_back(0.0f); // Embree alignment
-    RayTracer raytracer;
-    raytracer.attach_geometry_shared(positions, indices);
+    Rasterizer rasterizer;
+    rasterizer.attach_geometry(positions, indices);
 
     std::vector<float> projected_areas(proxies);
     for (size_t i = 0; i < projected_areas.size(); ++i) {
@@ -116,13 +51,8 @@ void proxy_view_selection(const Mesh& mesh,
                    cgal_to_eigen<float>(obb.axis((i + 1) % 3)));
         cam.set_extent(view_sphere.radius * 2.0f, view_sphere.radius * 2.0f);
 
-        std::vector<unsigned char> pixels(width * height, 0);
-        raytracer.render_silhouette(pixels.data(), cam, width, height);
-        auto proj = 0;
-        for (size_t j = 0; j < pixels.size(); ++j) {
-            if (pixels[j] != 0) { ++proj; }
-        }
-        projected_areas[i] = static_cast<float>(proj) / pixels.size();
+        auto proj = rasterizer.projected_area(cam, width, height);
+        projected_areas[i] = static_cast<float>(proj) / (width * height);
     }
     auto max_proj_area =
         *std::max_element(projected_areas.begin(), projected_areas.end());
@@ -1,15 +1,17 @@
+#include <Euclid/Geometry/KnnGraph.h>
 #include <Euclid/Geometry/MeshProperties.h>
+#include <Eigen/Dense>
+#include <Eigen/IterativeLinearSolvers>
+#include <Eigen/SparseCholesky>
 #include <Eigen/SparseCore>
 #include <Eigen/SparseLU>
-#include <CGAL/Orthogonal_k_neighbor_search.h>
-#include <CGAL/Search_traits_3.h>
-#include <CGAL/Search_traits_adapter.h>
-#include <boost/iterator/counting_iterator.hpp>
 #include <iterator>
 #include <vector>
 #include <tuple>
 #include <algorithm>
-#include <ostream>
+#include <iostream>
+#include <limits>
+#include <numeric>
 
 namespace Euclid
 {
@@ -17,251 +19,549 @@ namespace Euclid
 namespace _impl
 {
 
+// A weighted graph in compressed sparse rows
+template<typename FT>
+struct _WeightGraph
+{
+	std::vector<int> offsets;
+	std::vector<int> columns;
+	std::vector<FT> weights;
+};
+
+// Sort the entries of each row by column and sum the duplicates, e.g. of
+// two faces sharing two edges. Self loops are dropped, they do not change the
+// random walk once the other weights of the row are normalized, and the
+// systems have their own diagonal entries.
+template<typename FT>
+inline void _sort_rows(_WeightGraph<FT>& graph)
+{
+	const auto rows = static_cast<int>(graph.offsets.size()) - 1;
+	std::vector<int> counts(rows);
+#pragma omp parallel for
+	for (auto r = 0; r < rows; ++r) {
+		// Rows are short, insertion sort them in place
+		auto begin = graph.offsets[r];
+		auto end = graph.offsets[r + 1];
+		for (auto k = begin + 1; k < end; ++k) {
+			auto column = graph.columns[k];
+			auto weight = graph.weights[k];
+			auto j = k;
+			for (; j > begin && graph.columns[j - 1] > column; --j) {
+				graph.columns[j] = graph.columns[j - 1];
+				graph.weights[j] = graph.weights[j - 1];
+			}
+			graph.columns[j] = column;
+			graph.weights[j] = weight;
+		}
+		auto last = begin;
+		for (auto k = begin; k < end; ++k) {
+			if (graph.columns[k] == r) { continue; }
+			if (last > begin && graph.columns[last - 1] == graph.columns[k]) {
+				graph.weights[last - 1] += graph.weights[k];
+			}
+			else {
+				graph.columns[last] = graph.columns[k];
+				graph.weights[last] = graph.weights[k];
+				++last;
+			}
+		}
+		counts[r] = last - begin;
+	}
+
+	// Close the gaps left by the duplicates
+	auto size = 0;
+	for (auto r = 0; r < rows; ++r) {
+		auto begin = graph.offsets[r];
+		graph.offsets[r] = size;
+		for (auto k = begin; k < begin + counts[r]; ++k, ++size) {
+			graph.columns[size] = graph.columns[k];
+			graph.weights[size] = graph.weights[k];
+		}
+	}
+	graph.offsets[rows] = size;
+	graph.columns.resize(size);
+	graph.weights.resize(size);
+}
+
+// Average the weights of both directions of the edges, the rows of the input
+// must be sorted and so are the rows of the output
+template<typename FT>
+inline _WeightGraph<FT> _symmetrize(const _WeightGraph<FT>& graph)
+{
+	const auto rows = static_cast<int>(graph.offsets.size()) - 1;
+
+	// Transpose by counting sort, which keeps the rows sorted
+	_WeightGraph<FT> transposed;
+	transposed.offsets.assign(rows + 1, 0);
+	transposed.columns.resize(graph.columns.size());
+	transposed.weights.resize(graph.weights.size());
+	for (auto column : graph.columns) {
+		++transposed.offsets[column + 1];
+	}
+	for (auto r = 0; r < rows; ++r) {
+		transposed.offsets[r + 1] += transposed.offsets[r];
+	}
+	std::vector<int> positions(transposed.offsets.begin(), transposed.offsets.end() - 1);
+	for (auto r = 0; r < rows; ++r) {
+		for (auto k = graph.offsets[r]; k < graph.offsets[r + 1]; ++k) {
+			auto position = positions[graph.columns[k]]++;
+			transposed.columns[position] = r;
+			transposed.weights[position] = graph.weights[k];
+		}
+	}
+
+	// Merge the sorted rows of both, counting the entries first
+	auto merge = [&](int r, auto&& output) {
+		auto i = graph.offsets[r];
+		auto j = transposed.offsets[r];
+		while (i < graph.offsets[r + 1] || j < transposed.offsets[r + 1]) {
+			auto ci = i < graph.offsets[r + 1] ? graph.columns[i] : rows;
+			auto cj = j < transposed.offsets[r + 1] ? transposed.columns[j] : rows;
+			auto column = std::min(ci, cj);
+			FT weight = 0;
+			if (ci == column) { weight += graph.weights[i++]; }
+			if (cj == column) { weight += transposed.weights[j++]; }
+			output(column, static_cast<FT>(0.5) * weight);
+		}
+	};
+	_WeightGraph<FT> symmetric;
+	symmetric.offsets.assign(rows + 1, 0);
+#pragma omp parallel for
+	for (auto r = 0; r < rows; ++r) {
+		merge(r, [&](int, FT) { ++symmetric.offsets[r + 1]; });
+	}
+	for (auto r = 0; r < rows; ++r) {
+		symmetric.offsets[r + 1] += symmetric.offsets[r];
+	}
+	symmetric.columns.resize(symmetric.offsets[rows]);
+	symmetric.weights.resize(symmetric.offsets[rows]);
+#pragma omp parallel for
+	for (auto r = 0; r < rows; ++r) {
+		auto k = symmetric.offsets[r];
+		merge(r, [&](int column, FT weight) {
+			symmetric.columns[k] = column;
+			symmetric.weights[k] = weight;
+			++k;
+		});
+	}
+	return symmetric;
+}
+
+// Split the random walk on a graph of weights, whose first m rows and columns
+// are the seeds, into the linear system A X = B of the unseeded ones. The rows
+// of the graph must be sorted. The original system uses the transition
+// probabilities, i.e. the weights normalized by the degrees. The symmetric
+// one multiplies each row by its degree, which gives the graph laplacian, and
+// averages the weights of both directions of an edge, so it is positive
+// definite when every connected component has a seed.
+// The graph must not have self loops, which would duplicate the diagonal.
+// The rows of A and B are written directly from the graph in parallel.
+template<typename FT>
+inline void _random_walk_system(
+	const _WeightGraph<FT>& graph,
+	int m,
+	bool symmetric,
+	Eigen::SparseMatrix<FT>& A,
+	Eigen::SparseMatrix<FT>& B)
+{
+	using RowMat = Eigen::SparseMatrix<FT, Eigen::RowMajor>;
+
+	_WeightGraph<FT> averaged;
+	if (symmetric) { averaged = _symmetrize(graph); }
+	const auto& g = symmetric ? averaged : graph;
+	const auto n = static_cast<int>(g.offsets.size()) - 1 - m;
+
+	// The seeded columns of row r are [offsets[r], splits[r - m])
+	std::vector<int> splits(n);
+	std::vector<int> a_offsets(n + 1, 0);
+	std::vector<int> b_offsets(n + 1, 0);
+#pragma omp parallel for
+	for (auto i = 0; i < n; ++i) {
+		auto begin = g.offsets[i + m];
+		auto end = g.offsets[i + m + 1];
+		splits[i] = static_cast<int>(
+			std::lower_bound(g.columns.begin() + begin, g.columns.begin() + end, m) -
+			g.columns.begin());
+		b_offsets[i + 1] = splits[i] - begin;
+		a_offsets[i + 1] = end - splits[i] + 1; // And the diagonal
+	}
+	for (auto i = 0; i < n; ++i) {
+		a_offsets[i + 1] += a_offsets[i];
+		b_offsets[i + 1] += b_offsets[i];
+	}
+
+	std::vector<int> a_columns(a_offsets[n]);
+	std::vector<FT> a_values(a_offsets[n]);
+	std::vector<int> b_columns(b_offsets[n]);
+	std::vector<FT> b_values(b_offsets[n]);
+#pragma omp parallel for
+	for (auto i = 0; i < n; ++i) {
+		auto begin = g.offsets[i + m];
+		auto end = g.offsets[i + m + 1];
+		FT degree = 0;
+		for (auto k = begin; k < end; ++k) {
+			degree += g.weights[k];
+		}
+		// Isolated elements keep a unit diagonal
+		if (!(degree > 0)) { degree = 1; }
+		const FT scale = symmetric ? 1 : 1 / degree;
+
+		auto b = b_offsets[i];
+		for (auto k = begin; k < splits[i]; ++k, ++b) {
+			b_columns[b] = g.columns[k];
+			b_values[b] = g.weights[k] * scale;
+		}
+		auto a = a_offsets[i];
+		auto k = splits[i];
+		for (; k < end && g.columns[k] - m < i; ++k, ++a) {
+			a_columns[a] = g.columns[k] - m;
+			a_values[a] = -g.weights[k] * scale;
+		}
+		a_columns[a] = i;
+		a_values[a++] = symmetric ? degree : 1;
+		for (; k < end; ++k, ++a) {
+			a_columns[a] = g.columns[k] - m;
+			a_values[a] = -g.weights[k] * scale;
+		}
+	}
+
+	// The solvers take column major matrices
+	A = Eigen::Map<const RowMat>(n, n, a_offsets[n],
+		a_offsets.data(), a_columns.data(), a_values.data());
+	B = Eigen::Map<const RowMat>(n, m, b_offsets[n],
+		b_offsets.data(), b_columns.data(), b_values.data());
+	A.makeCompressed();
+	B.makeCompressed();
+}
+
 // Construct linear system for mesh
 template<typename Mesh, typename FT>
 inline void _construct_equation(
 	const Mesh& mesh,
 	const std::vector<int>& ids,
+	bool symmetric,
 	Eigen::SparseMatrix<FT>& A,
 	Eigen::SparseMatrix<FT>& B)
 {
-	using SpMat = Eigen::SparseMatrix<FT>;
+	using FaceDescriptor = typename boost::graph_traits<Mesh>::face_descriptor;
+	using HalfedgeDescriptor = typename boost::graph_traits<Mesh>::halfedge_descriptor;
+	using VertexPointMap = typename boost::property_map<Mesh, boost::vertex_point_t>::const_type;
+	using Point_3 = typename boost::property_traits<VertexPointMap>::value_type;
+	using Vector_3 = typename CGAL::Kernel_traits<Point_3>::Kernel::Vector_3;
 
 	auto fimap = get(boost::face_index, mesh);
 	auto vpmap = get(CGAL::vertex_point, mesh);
-	auto m = B.cols();
-	auto n = B.rows();
-	auto sum = 0.0;
-	auto n_faces = num_faces(mesh);
-	std::vector<int> rows;
-	std::vector<int> cols;
-	std::vector<FT> edge_len;
-	std::vector<FT> ds;
-	rows.reserve(3 * n_faces);
-	cols.reserve(3 * n_faces);
-	edge_len.reserve(3 * n_faces);
-	ds.reserve(3 * n_faces);
-
-	// Compute the ingredients of the laplacian matrix
-	boost::graph_traits<const Mesh>::face_iterator fa, f_end;
-	std::tie(fa, f_end) = faces(mesh);
-	for (; fa != f_end; ++fa) {
-		auto fa_id = ids[fimap[*fa]];
-		auto facet_sum = 0.0;
-		auto na = Euclid::face_normal(*fa, mesh);
-
-		auto fit_end = halfedge(*fa, mesh);
+	auto m = static_cast<int>(B.cols());
+	auto n_faces = static_cast<int>(num_faces(mesh));
+
+	// The dual graph, i.e. the faces adjacent to each face through its
+	// interior edges, and the halfedges crossed, by face index
+	std::vector<FaceDescriptor> face_list(n_faces);
+	for (auto f : faces(mesh)) {
+		face_list[fimap[f]] = f;
+	}
+	std::vector<int> dual_offsets(n_faces + 1, 0);
+	std::vector<int> dual_faces;
+	std::vector<HalfedgeDescriptor> crossings;
+	dual_faces.reserve(3 * n_faces);
+	crossings.reserve(3 * n_faces);
+	for (auto i = 0; i < n_faces; ++i) {
+		auto fit_end = halfedge(face_list[i], mesh);
 		auto fit = fit_end;
 		do {
 			auto oppo = opposite(fit, mesh);
 			if (!is_border(oppo, mesh)) { // Non-boundary
-				edge_len.push_back(Euclid::edge_length(fit, mesh));
-
-				// Determine whether the incident edge is concave or convex
-				auto pa = vpmap[target(next(fit, mesh), mesh)];
-				auto pb = vpmap[target(next(oppo, mesh), mesh)];
-				auto p = pb - pa;
-				auto eta = p * na <= 0.0 ? 0.2 : 1.0;
-
-				auto fb = face(oppo, mesh);
-				auto fb_id = ids[fimap[fb]];
-				auto nb = Euclid::face_normal(fb, mesh);
-				auto diff = 0.5 * eta * (na - nb).squared_length();
-
-				cols.push_back(fa_id);
-				rows.push_back(fb_id);
-				ds.push_back(diff);
-				facet_sum += diff;
-			}
-			else { // Placeholder
-				ds.push_back(-1.0);
+				dual_faces.push_back(static_cast<int>(fimap[face(oppo, mesh)]));
+				crossings.push_back(fit);
 			}
 			fit = next(fit, mesh);
 		} while (fit != fit_end);
+		dual_offsets[i + 1] = static_cast<int>(dual_faces.size());
+	}
+	const auto n_edges = static_cast<int>(dual_faces.size());
 
-		sum += facet_sum;
+	// Each face normal is computed once
+	std::vector<Vector_3> normals(n_faces);
+#pragma omp parallel for
+	for (auto i = 0; i < n_faces; ++i) {
+		normals[i] = Euclid::face_normal(face_list[i], mesh);
 	}
 
-	// Normalize
-	std::vector<Eigen::Triplet<FT>> values;
-	values.reserve(cols.size());
-	const auto inv_sigma = 1.0; // Parameter
-	auto inv_avg = edge_len.size() / (sum * 0.5);
-	auto d_iter = ds.begin();
-	auto e_iter = edge_len.begin();
-	auto c_iter = cols.begin();
-	auto r_iter = rows.begin();
-	while (d_iter != ds.end()) {
-		auto prob_sum = static_cast<FT>(0.0);
-		for (auto j = 0; j < 3; ++j) {
-			if (*d_iter != -1.0) {
-				auto prob = std::exp(-(*d_iter * inv_avg) * inv_sigma) * *e_iter++;
-				*d_iter++ = -prob;
-				prob_sum += prob;
-			}
-			else {
-				++d_iter;
-			}
-		}
-		prob_sum = 1.0 / prob_sum;
-		d_iter -= 3;
-		for (auto j = 0; j < 3; ++j) {
-			if (*d_iter != -1.0) {
-				values.emplace_back(*c_iter++, *r_iter++, *d_iter++ * prob_sum);
-			}
-			else {
-				++d_iter;
-			}
+	// Compute the ingredients of the laplacian matrix
+	std::vector<FT> ds(n_edges);
+	std::vector<FT> edge_len(n_edges);
+	std::vector<double> face_sums(n_faces, 0.0);
+#pragma omp parallel for
+	for (auto i = 0; i < n_faces; ++i) {
+		const auto& na = normals[i];
+		for (auto k = dual_offsets[i]; k < dual_offsets[i + 1]; ++k) {
+			auto fit = crossings[k];
+			auto oppo = opposite(fit, mesh);
+			edge_len[k] = Euclid::edge_length(fit, mesh);
+
+			// Determine whether the incident edge is concave or convex
+			auto pa = vpmap[target(next(fit, mesh), mesh)];
+			auto pb = vpmap[target(next(oppo, mesh), mesh)];
+			auto p = pb - pa;
+			auto eta = p * na <= 0.0 ? 0.2 : 1.0;
+
+			const auto& nb = normals[dual_faces[k]];
+			auto diff = 0.5 * eta * (na - nb).squared_length();
+			ds[k] = diff;
+			face_sums[i] += diff;
 		}
 	}
 
-	for (boost::graph_traits<Mesh>::faces_size_type i = 0; i < num_faces(mesh); ++i) {
-		values.emplace_back(i, i, static_cast<FT>(1.0));
-	}
+	// Summed in order, so the weights do not depend on the number of threads
+	auto sum = std::accumulate(face_sums.begin(), face_sums.end(), 0.0);
 
-	// Fill in the matrix
-	SpMat L(m + n, m + n);
-	L.setFromTriplets(values.begin(), values.end());
-	A = L.bottomRightCorner(n, n);
-	B = -L.bottomLeftCorner(n, m);
-	A.makeCompressed();
-	B.makeCompressed();
+	// Weights of the dual edges by matrix ID, normalized by the random walk
+	// system
+	const auto inv_sigma = 1.0; // Parameter
+	auto inv_avg = n_edges / (sum * 0.5);
+	std::vector<int> inv_ids(n_faces);
+	for (auto i = 0; i < n_faces; ++i) {
+		inv_ids[ids[i]] = i;
+	}
+	_WeightGraph<FT> graph;
+	graph.offsets.assign(n_faces + 1, 0);
+	for (auto r = 0; r < n_faces; ++r) {
+		auto i = inv_ids[r];
+		graph.offsets[r + 1] = graph.offsets[r] + dual_offsets[i + 1] - dual_offsets[i];
+	}
+	graph.columns.resize(n_edges);
+	graph.weights.resize(n_edges);
+#pragma omp parallel for
+	for (auto r = 0; r < n_faces; ++r) {
+		auto i = inv_ids[r];
+		auto dst = graph.offsets[r];
+		for (auto k = dual_offsets[i]; k < dual_offsets[i + 1]; ++k, ++dst) {
+			auto prob = std::exp(-(ds[k] * inv_avg) * inv_sigma) * edge_len[k];
+			graph.columns[dst] = ids[dual_faces[k]];
+			graph.weights[dst] = static_cast<FT>(prob);
+		}
+	}
+	_sort_rows(graph);
+	_random_walk_system(graph, m, symmetric, A, B);
 }
 
 // Construct linear system for point cloud
-template<typename ForwardIterator, typename Index, typename PPMap, typename NPMap, typename FT>
+template<typename PPMap, typename NPMap, typename Index, typename FT>
 inline void _construct_equation(
-	ForwardIterator first,
-	ForwardIterator beyond,
 	PPMap point_pmap,
 	NPMap normal_pmap,
-	const std::vector<std::vector<int>>& neighbors,
+	const KnnGraph<FT>& neighbors,
 	const std::vector<Index>& indices,
 	const std::vector<int>& ids,
+	bool symmetric,
 	Eigen::SparseMatrix<FT>& A,
 	Eigen::SparseMatrix<FT>& B)
 {
-	using SpMat = Eigen::SparseMatrix<FT>;
-
 	const auto inv_sigma1 = 1.0;
 	const auto inv_sigma2 = 1.0;
-	auto m = B.cols();
-	auto n = B.rows();
+	auto m = static_cast<int>(B.cols());
+	auto n = static_cast<int>(B.rows());
 	auto n_points = m + n;
-	auto n_neighbors = neighbors[0].size();
-	std::vector<int> rows;
-	std::vector<int> cols;
-	std::vector<FT> d1s;
-	std::vector<FT> d2s;
-	rows.reserve(n_points * n_neighbors);
-	cols.reserve(n_points * n_neighbors);
-	d1s.reserve(n_points * n_neighbors);
-	d2s.reserve(n_points * n_neighbors);
-	auto d2_sum = 0.0;
-
-	// Compute the ingredients of the laplacian matrix
-	auto i = 0;
-	for (auto iter = first; iter != beyond; ++iter, ++i) {
-		auto pi = point_pmap[*iter];
-		auto ni = normal_pmap[*iter];
+	auto n_edges = static_cast<int>(neighbors.neighbors.size());
+	std::vector<FT> d1s(n_edges);
+	std::vector<FT> d2s(n_edges);
+	std::vector<double> d2_sums(n_points, 0.0);
+
+	// Compute the ingredients of the laplacian matrix, the points are
+	// indices[i] in the order of the range
+#pragma omp parallel for
+	for (auto i = 0; i < n_points; ++i) {
+		auto pi = point_pmap[indices[i]];
+		auto ni = normal_pmap[indices[i]];
 		auto d1_sum = 0.0;
 
-		for (auto j = 0; j < n_neighbors; ++j) {
-			auto neighbor = neighbors[i][j];
-			cols.push_back(ids[i]);
-			rows.push_back(ids[neighbor]);
-
+		for (auto idx = neighbors.offsets[i]; idx < neighbors.offsets[i + 1]; ++idx) {
+			auto neighbor = neighbors.neighbors[idx];
 			auto pj = point_pmap[indices[neighbor]];
 			auto nj = normal_pmap[indices[neighbor]];
 			auto eta = ((pj - pi) - ((pj - pi) * ni) * ni) * nj >= 0.0 ? 0.2 : 1.0; // convex : concave
 
 			auto d1 = (pi - pj).squared_length();
-			d1s.push_back(d1);
+			d1s[idx] = d1;
 			d1_sum += d1;
 			auto d2 = 0.5 * eta * (ni - nj).squared_length();
-			d2s.push_back(d2);
-			d2_sum += d2;
+			d2s[idx] = d2;
+			d2_sums[i] += d2;
 		}
 
-		auto d1_inv_avg = n_neighbors / d1_sum;
-		for (auto j = 0; j < n_neighbors; ++j) {
-			auto idx = i * n_neighbors + j;
+		auto d1_inv_avg = neighbors.degree(i) / d1_sum;
+		for (auto idx = neighbors.offsets[i]; idx < neighbors.offsets[i + 1]; ++idx) {
 			d1s[idx] = std::exp(-d1s[idx] * d1_inv_avg * inv_sigma1);
 		}
 	}
 
-	auto d2_inv_avg = (n_points * n_neighbors) / d2_sum;
-	for (auto& d2 : d2s) {
-		d2 = std::exp(-d2 * d2_inv_avg * inv_sigma2);
-	}
+	// Summed in order, so the weights do not depend on the number of threads
+	auto d2_sum = std::accumulate(d2_sums.begin(), d2_sums.end(), 0.0);
 
-	// Normalize
-	std::vector<Eigen::Triplet<FT>> values;
-	values.reserve(n_points * (n_neighbors + 1));
+	// Weights of the neighbors by matrix ID, normalized by the random walk
+	// system
+	auto d2_inv_avg = n_edges / d2_sum;
+	std::vector<int> inv_ids(n_points);
 	for (auto i = 0; i < n_points; ++i) {
-		std::vector<FT> ds(n_neighbors);
-		FT sum = 0.0;
-		for (auto j = 0; j < n_neighbors; ++j) {
-			auto idx = i * n_neighbors + j;
-			ds[j] = d1s[idx] * d2s[idx];
-			sum += ds[j];
-		}
-		FT inv_sum = 1.0 / sum;
-		for (auto j = 0; j < n_neighbors; ++j) {
-			auto idx = i * n_neighbors + j;
-			values.emplace_back(cols[idx], rows[idx], -ds[j] * inv_sum);
+		inv_ids[ids[i]] = i;
+	}
+	_WeightGraph<FT> graph;
+	graph.offsets.assign(n_points + 1, 0);
+	for (auto r = 0; r < n_points; ++r) {
+		graph.offsets[r + 1] = graph.offsets[r] + neighbors.degree(inv_ids[r]);
+	}
+	graph.columns.resize(n_edges);
+	graph.weights.resize(n_edges);
+#pragma omp parallel for
+	for (auto r = 0; r < n_points; ++r) {
+		auto i = inv_ids[r];
+		auto dst = graph.offsets[r];
+		for (auto idx = neighbors.offsets[i]; idx < neighbors.offsets[i + 1]; ++idx, ++dst) {
+			auto d2 = std::exp(-d2s[idx] * d2_inv_avg * inv_sigma2);
+			graph.columns[dst] = ids[neighbors.neighbors[idx]];
+			graph.weights[dst] = static_cast<FT>(d1s[idx] * d2);
 		}
-		values.emplace_back(i, i, static_cast<FT>(1.0));
 	}
-
-	// Fill in the matrix
-	SpMat L(m + n, m + n);
-	L.setFromTriplets(values.begin(), values.end());
-	A = L.bottomRightCorner(n, n);
-	B = -L.bottomLeftCorner(n, m);
-	A.makeCompressed();
-	B.makeCompressed();
+	_sort_rows(graph);
+	_random_walk_system(graph, m, symmetric, A, B);
 }
 
-// Adapt PointPropertyMap to take in integer as key type
-template<typename PPMap>
-class IPMapAdaptor
+// Solve A X = B of all seeds and find the seed of the largest probability of
+// each unseeded element, ties go to the first seed. The columns of B are
+// solved in dense blocks in parallel, and each block is reduced right after
+// its solve, so the solutions of all seeds are never stored at once.
+// solve(b, x) must be safe to call concurrently.
+template<typename FT, typename Solve>
+inline bool _solve_argmax(
+	const Eigen::SparseMatrix<FT>& B,
+	Solve&& solve,
+	std::vector<int>& labels)
 {
-	using PointKey = typename boost::property_traits<PPMap>::key_type;
-	using Point_3 = typename boost::property_traits<PPMap>::value_type;
-
-public:
-	using value_type = Point_3;
-	using reference = const value_type&;
-	using key_type = int;
-	using category = boost::lvalue_property_map_tag;
-
-	IPMapAdaptor(PPMap ppmap, const std::vector<PointKey>& pks)
-		: _ppmap(ppmap), _pks(pks) {}
-
-	reference operator[](key_type key) const
+	using Dense = Eigen::Matrix<FT, Eigen::Dynamic, Eigen::Dynamic>;
+	const int block = 8; // Columns per block
+	const auto n = static_cast<int>(B.rows());
+	const auto m = static_cast<int>(B.cols());
+	const auto n_blocks = (m + block - 1) / block;
+
+	std::vector<FT> max_probabilities(n, std::numeric_limits<FT>::lowest());
+	labels.assign(n, m);
+	bool success = true;
+#pragma omp parallel
 	{
-		return _ppmap[_pks[key]];
-	}
+		std::vector<FT> local_max(n, std::numeric_limits<FT>::lowest());
+		std::vector<int> local_labels(n, m);
+		Dense b, x;
+
+#pragma omp for schedule(dynamic)
+		for (auto k = 0; k < n_blocks; ++k) {
+			auto first = k * block;
+			auto cols = std::min(block, m - first);
+			b = B.middleCols(first, cols);
+			if (!solve(b, x)) {
+#pragma omp atomic write
+				success = false;
+				continue;
+			}
+			for (auto c = 0; c < cols; ++c) {
+				for (auto j = 0; j < n; ++j) {
+					if (x(j, c) > local_max[j]) {
+						local_max[j] = x(j, c);
+						local_labels[j] = first + c;
+					}
+				}
+			}
+		}
 
-	friend reference get(IPMapAdaptor ipmap, key_type key)
-	{
-		return ipmap[key];
+		// Blocks may finish in any order, so compare the seeds on ties
+#pragma omp critical
+		for (auto j = 0; j < n; ++j) {
+			if (local_max[j] > max_probabilities[j] ||
+				(local_max[j] == max_probabilities[j] && local_labels[j] < labels[j])) {
+				max_probabilities[j] = local_max[j];
+				labels[j] = local_labels[j];
+			}
+		}
 	}
+	return success;
+}
 
-private:
-	PPMap _ppmap;
-	const std::vector<PointKey>& _pks;
-};
+// Label the unseeded elements by the index of the seed they most likely
+// walk to, using the given solver
+template<typename FT>
+inline bool _random_walk_labels(
+	const Eigen::SparseMatrix<FT>& A,
+	const Eigen::SparseMatrix<FT>& B,
+	RandomWalkSolver solver,
+	std::vector<int>& labels)
+{
+	using SpMat = Eigen::SparseMatrix<FT>;
+	using Dense = Eigen::Matrix<FT, Eigen::Dynamic, Eigen::Dynamic>;
+	const auto tolerance = static_cast<FT>(1e-6);
+
+	switch (solver) {
+	case RandomWalkSolver::ldlt: {
+		Eigen::SimplicialLDLT<SpMat> ldlt(A);
+		if (ldlt.info() != Eigen::Success) {
+			std::cerr << "LDLT factorization failed." << std::endl;
+			return false;
+		}
+		return _solve_argmax(B, [&ldlt](const Dense& b, Dense& x) {
+			x = ldlt.solve(b);
+			return true;
+		}, labels);
+	}
+	case RandomWalkSolver::conjugate_gradient: {
+		// Iterative solvers keep states of the last solve, use one per block
+		auto success = _solve_argmax(B, [&A, tolerance](const Dense& b, Dense& x) {
+			Eigen::ConjugateGradient<SpMat, Eigen::Lower | Eigen::Upper> cg(A);
+			cg.setTolerance(tolerance);
+			x = cg.solve(b);
+			return cg.info() == Eigen::Success;
+		}, labels);
+		if (!success) {
+			std::cerr << "Conjugate gradient did not converge." << std::endl;
+		}
+		return success;
+	}
+	case RandomWalkSolver::bicgstab: {
+		auto success = _solve_argmax(B, [&A, tolerance](const Dense& b, Dense& x) {
+			Eigen::BiCGSTAB<SpMat> bicgstab(A);
+			bicgstab.setTolerance(tolerance);
+			x = bicgstab.solve(b);
+			return bicgstab.info() == Eigen::Success;
+		}, labels);
+		if (!success) {
+			std::cerr << "BiCGSTAB did not converge." << std::endl;
+		}
+		return success;
+	}
+	case RandomWalkSolver::sparse_lu: {
+		Eigen::SparseLU<SpMat> lu(A);
+		if (lu.info() != Eigen::Success) {
+			std::cerr << lu.lastErrorMessage() << std::endl;
+			return false;
+		}
+		return _solve_argmax(B, [&lu](const Dense& b, Dense& x) {
+			x = lu.solve(b);
+			return true;
+		}, labels);
+	}
+	}
+	return false;
+}
 
 } // namespace _impl
 
 template<typename Mesh>
-inline void random_walk_segmentation(const Mesh& mesh, std::vector<int>& seed_indices, std::vector<int>& face_class)
+inline void random_walk_segmentation(
+	const Mesh& mesh,
+	std::vector<int>& seed_indices,
+	std::vector<int>& face_class,
+	RandomWalkSolver solver)
 {
-	using VertexPointMap = boost::property_map<Mesh, boost::vertex_point_t>::type;
-	using Point_3 = boost::property_traits<VertexPointMap>::value_type;
-	using FT = CGAL::Kernel_traits<Point_3>::Kernel::FT;
+	using VertexPointMap = typename boost::property_map<Mesh, boost::vertex_point_t>::type;
+	using Point_3 = typename boost::property_traits<VertexPointMap>::value_type;
+	using FT = typename CGAL::Kernel_traits<Point_3>::Kernel::FT;
 	using SpMat = Eigen::SparseMatrix<FT>;
 
 	// Construct the linear equation
@@ -281,7 +581,9 @@ inline void random_walk_segmentation(const Mesh& mesh, std::vector<int>& seed_in
 	}
 	SpMat A(n, n);
 	SpMat B(n, m);
-	_impl::_construct_equation(mesh, ids, A, B);
+	const bool symmetric = solver == RandomWalkSolver::ldlt ||
+		solver == RandomWalkSolver::conjugate_gradient;
+	_impl::_construct_equation(mesh, ids, symmetric, A, B);
 
 	std::vector<int> inv_ids(m + n);
 	for (auto i = 0; i < m + n; ++i) {
@@ -293,22 +595,12 @@ inline void random_walk_segmentation(const Mesh& mesh, std::vector<int>& seed_in
 	for (auto s : seed_indices) {
 		face_class[s] = s;
 	}
-	std::vector<FT> max_probabilities(n, static_cast<FT>(-1.0));
-	Eigen::SparseLU<SpMat> solver;
-	solver.compute(A);
-	if (solver.info() != Eigen::Success) {
-		std::cerr << solver.lastErrorMessage() << std::endl;
+	std::vector<int> labels;
+	if (!_impl::_random_walk_labels(A, B, solver, labels)) {
 		return;
 	}
-	for (auto i = 0; i < m; ++i) {
-		Eigen::Matrix<FT, Eigen::Dynamic, 1> b = B.col(i);
-		Eigen::Matrix<FT, Eigen::Dynamic, 1> x = solver.solve(b);
-		for (auto j = 0; j < n; ++j) {
-			if (x(j, 0) > max_probabilities[j]) {
-				max_probabilities[j] = x(j, 0);
-				face_class[inv_ids[j + m]] = seed_indices[i];
-			}
-		}
+	for (auto j = 0; j < n; ++j) {
+		face_class[inv_ids[j + m]] = seed_indices[labels[j]];
 	}
 }
 
@@ -319,58 +611,21 @@ inline void random_walk_segmentation(
 	PPMap point_pmap,
 	NPMap normal_pmap,
 	std::vector<int>& seed_indices,
-	std::vector<int>& point_class)
+	std::vector<int>& point_class,
+	RandomWalkSolver solver)
 {
-	using Index = std::iterator_traits<ForwardIterator>::value_type;
-	using Point_3 = boost::property_traits<PPMap>::value_type;
-	using Vector_3 = boost::property_traits<NPMap>::value_type;
-	using Kernel = CGAL::Kernel_traits<Point_3>::Kernel;
-	using IPMap = _impl::IPMapAdaptor<PPMap>;
-	using BaseTraits = CGAL::Search_traits_3<Kernel>;
-	using KdTreeTraits = CGAL::Search_traits_adapter<int, IPMap, BaseTraits>;
-	using KNN = CGAL::Orthogonal_k_neighbor_search<KdTreeTraits>;
-	using KdTree = typename KNN::Tree;
-	using Splitter = KdTree::Splitter;
-	using Distance = KNN::Distance;
-	using FT = Kernel::FT;
+	using Index = typename std::iterator_traits<ForwardIterator>::value_type;
+	using Point_3 = typename boost::property_traits<PPMap>::value_type;
+	using FT = typename CGAL::Kernel_traits<Point_3>::Kernel::FT;
 	using SpMat = Eigen::SparseMatrix<FT>;
 	const int k = 6; // Use 6 neighbors according to Euler formula
 
-	// Construct the IPMap
-	std::vector<Index> indices;
-	int n = 0;
-	for (auto iter = first; iter != beyond; ++iter) {
-		indices.push_back(*iter);
-		++n;
-	}
-	IPMap ipmap(point_pmap, indices);
-
-	// Construct the k-d tree
-	KdTree tree(
-		boost::counting_iterator<int>(0),
-		boost::counting_iterator<int>(n),
-		Splitter(),
-		KdTreeTraits(ipmap)
-	);
-	Distance dist(ipmap);
-
-	// Query neighbors for all points and store the neighbors' indices
-	std::vector<std::vector<int>> neighbors;
-	for (auto iter = first; iter < beyond; ++iter) {
-		std::vector<int> neighbors_i;
-		neighbors_i.reserve(k);
-
-		auto p = point_pmap[*iter];
-		KNN knn(tree, p, k + 1, static_cast<FT>(0.00001), true, dist);
-
-		auto it = knn.begin();
-		++it; // The first will always return the identical point
-		for (it; it != knn.end(); ++it) {
-			neighbors_i.push_back(it->first);
-		}
+	std::vector<Index> indices(first, beyond);
+	int n = static_cast<int>(indices.size());
 
-		neighbors.push_back(neighbors_i);
-	}
+	// Query neighbors for all points
+	KnnGraph<FT> neighbors;
+	knn_graph(indices.begin(), indices.end(), point_pmap, k, neighbors);
 
 	// Construct the linear equation
 	auto m = static_cast<int>(seed_indices.size()); // Number of seeded
@@ -389,8 +644,10 @@ inline void random_walk_segmentation(
 			id = inc++;
 		}
 	}
-	_impl::_construct_equation(first, beyond, point_pmap, normal_pmap,
-		neighbors, indices, ids, A, B);
+	const bool symmetric = solver == RandomWalkSolver::ldlt ||
+		solver == RandomWalkSolver::conjugate_gradient;
+	_impl::_construct_equation(point_pmap, normal_pmap,
+		neighbors, indices, ids, symmetric, A, B);
 
 	std::vector<int> inv_ids(m + n);
 	for (auto i = 0; i < m + n; ++i) {
@@ -402,22 +659,12 @@ inline void random_walk_segmentation(
 	for (auto s : seed_indices) {
 		point_class[s] = s;
 	}
-	std::vector<FT> max_probabilities(n, static_cast<FT>(-1.0));
-	Eigen::SparseLU<SpMat> solver;
-	solver.compute(A);
-	if (solver.info() != Eigen::Success) {
-		std::cerr << solver.lastErrorMessage() << std::endl;
+	std::vector<int> labels;
+	if (!_impl::_random_walk_labels(A, B, solver, labels)) {
 		return;
 	}
-	for (auto i = 0; i < m; ++i) {
-		Eigen::Matrix<FT, Eigen::Dynamic, 1> b = B.col(i);
-		Eigen::Matrix<FT, Eigen::Dynamic, 1> x = solver.solve(b);
-		for (auto j = 0; j < n; ++j) {
-			if (x(j, 0) > max_probabilities[j]) {
-				max_probabilities[j] = x(j, 0);
-				point_class[inv_ids[j + m]] = seed_indices[i];
-			}
-		}
+	for (auto j = 0; j < n; ++j) {
+		point_class[inv_ids[j + m]] = seed_indices[labels[j]];
 	}
 }
 
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstdint>
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <Eigen/Dense>
+#include <Euclid/Geometry/MeshHelpers.h>
+#include <Euclid/Render/RayTracer.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Shape diameter of a face from the hit distances and angles of its rays
+inline float _filtered_diameter(const std::vector<float>& distances,
+                                const std::vector<float>& weights)
+{
+    if (distances.empty()) { return 0.0f; }
+
+    std::vector<float> sorted(distances);
+    auto mid = sorted.begin() + sorted.size() / 2;
+    std::nth_element(sorted.begin(), mid, sorted.end());
+    const auto median = *mid;
+
+    auto mean = 0.0f;
+    for (auto d : distances) {
+        mean += d;
+    }
+    mean /= distances.size();
+    auto variance = 0.0f;
+    for (auto d : distances) {
+        variance += (d - mean) * (d - mean);
+    }
+    const auto stddev = std::sqrt(variance / distances.size());
+
+    auto sum = 0.0f;
+    auto total = 0.0f;
+    for (size_t i = 0; i < distances.size(); ++i) {
+        if (std::abs(distances[i] - median) <= stddev) {
+            sum += weights[i] * distances[i];
+            total += weights[i];
+        }
+    }
+    return total > 0.0f ? sum / total : median;
+}
+
+// Average the values of each face with its edge-adjacent faces, faces
+// without a value are skipped
+template<typename T>
+void _smooth_face_values(const std::vector<unsigned>& indices,
+                         std::vector<T>& values,
+                         int iterations)
+{
+    const int n = static_cast<int>(indices.size() / 3);
+    std::vector<int> neighbors(3 * n, -1);
+    std::unordered_map<uint64_t, int> edges;
+    for (int f = 0; f < n; ++f) {
+        for (int i = 0; i < 3; ++i) {
+            uint64_t v0 = indices[3 * f + i];
+            uint64_t v1 = indices[3 * f + (i + 1) % 3];
+            auto key = (std::min(v0, v1) << 32) | std::max(v0, v1);
+            auto iter = edges.find(key);
+            if (iter == edges.end()) {
+                edges.emplace(key, 3 * f + i);
+            }
+            else {
+                neighbors[3 * f + i] = iter->second / 3;
+                neighbors[iter->second] = f;
+            }
+        }
+    }
+
+    std::vector<T> smoothed(values.size());
+    for (int iter = 0; iter < iterations; ++iter) {
+#pragma omp parallel for
+        for (int f = 0; f < n; ++f) {
+            smoothed[f] = values[f];
+            if (values[f] == T(0)) { continue; }
+            T sum = values[f];
+            int count = 1;
+            for (int i = 0; i < 3; ++i) {
+                auto g = neighbors[3 * f + i];
+                if (g >= 0 && values[g] != T(0)) {
+                    sum += values[g];
+                    ++count;
+                }
+            }
+            smoothed[f] = sum / count;
+        }
+        values.swap(smoothed);
+    }
+}
+
+} // namespace _impl
+
+template<typename Mesh, typename T>
+void shape_diameter_function(const Mesh& mesh,
+                             std::vector<T>& sdf,
+                             float cone_angle,
+                             int rays,
+                             int smooth_iterations,
+                             unsigned seed)
+{
+    if (cone_angle <= 0.0f || cone_angle > 180.0f) {
+        throw std::invalid_argument("Cone angle should be in range (0, 180]");
+    }
+    if (rays <= 0) {
+        throw std::invalid_argument("Number of rays must be positive.");
+    }
+
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    extract_mesh<3>(mesh, positions, indices);
+    const int n_faces = static_cast<int>(indices.size() / 3);
+
+    std::vector<Eigen::Vector3f> centroids;
+    std::vector<Eigen::Vector3f> normals;
+    _impl::_face_frames(positions, indices, centroids, normals);
+    const auto epsilon = _impl::_ray_epsilon(positions);
+
+    RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+    auto scene = raytracer.scene();
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+
+    // Directions are uniformly distributed over the spherical cap
+    const auto cos_half_angle =
+        std::cos(0.5f * cone_angle * static_cast<float>(M_PI) / 180.0f);
+    sdf.resize(n_faces);
+
+#pragma omp parallel
+    {
+        std::vector<float> distances;
+        std::vector<float> weights;
+        distances.reserve(rays);
+        weights.reserve(rays);
+
+#pragma omp for schedule(dynamic, 64)
+        for (int f = 0; f < n_faces; ++f) {
+            distances.clear();
+            weights.clear();
+            Eigen::Vector3f axis = -normals[f];
+            Eigen::Vector3f b1, b2;
+            _impl::_orthonormal_basis(axis, b1, b2);
+
+            for (int first = 0; first < rays; first += 8) {
+                alignas(32) int valid[8];
+                float angles[8];
+                RTCRayHit8 rayhits;
+                for (int j = 0; j < 8; ++j) {
+                    const int k = first + j;
+                    valid[j] = k < rays ? -1 : 0;
+                    float s = 0.0f, t = 0.0f;
+                    if (k < rays) {
+                        _impl::_stratified_sample(seed, f, k, rays, s, t);
+                    }
+                    const auto cos_theta = 1.0f - s * (1.0f - cos_half_angle);
+                    const auto sin_theta = std::sqrt(
+                        std::max(0.0f, 1.0f - cos_theta * cos_theta));
+                    const auto phi = 2.0f * static_cast<float>(M_PI) * t;
+                    Eigen::Vector3f dir = sin_theta * std::cos(phi) * b1 +
+                                          sin_theta * std::sin(phi) * b2 +
+                                          cos_theta * axis;
+                    angles[j] = std::acos(std::min(cos_theta, 1.0f));
+
+                    rayhits.ray.org_x[j] = centroids[f](0);
+                    rayhits.ray.org_y[j] = centroids[f](1);
+                    rayhits.ray.org_z[j] = centroids[f](2);
+                    rayhits.ray.dir_x[j] = dir(0);
+                    rayhits.ray.dir_y[j] = dir(1);
+                    rayhits.ray.dir_z[j] = dir(2);
+                    rayhits.ray.tnear[j] = epsilon;
+                    rayhits.ray.tfar[j] = std::numeric_limits<float>::max();
+                    rayhits.ray.time[j] = 0.0f;
+                    rayhits.ray.mask[j] = 0xFFFFFFFF;
+                    rayhits.ray.id[j] = j;
+                    rayhits.ray.flags[j] = 0;
+                    rayhits.hit.geomID[j] = RTC_INVALID_GEOMETRY_ID;
+                    rayhits.hit.instID[0][j] = RTC_INVALID_GEOMETRY_ID;
+                }
+                rtcIntersect8(valid, scene, &context, &rayhits);
+
+                for (int j = 0; j < 8; ++j) {
+                    if (valid[j] == 0 ||
+                        rayhits.hit.geomID[j] == RTC_INVALID_GEOMETRY_ID) {
+                        continue;
+                    }
+                    // Only hits on the inner side of the surface count
+                    Eigen::Vector3f dir(rayhits.ray.dir_x[j],
+                                        rayhits.ray.dir_y[j],
+                                        rayhits.ray.dir_z[j]);
+                    if (dir.dot(normals[rayhits.hit.primID[j]]) <= 0.0f) {
+                        continue;
+                    }
+                    distances.push_back(rayhits.ray.tfar[j]);
+                    // Avoid infinite weights for rays along the axis
+                    weights.push_back(1.0f / std::max(angles[j], 1e-3f));
+                }
+            }
+            sdf[f] = static_cast<T>(
+                _impl::_filtered_diameter(distances, weights));
+        }
+    }
+
+    if (smooth_iterations > 0) {
+        _impl::_smooth_face_values(indices, sdf, smooth_iterations);
+    }
+}
+
+} // namespace Euclid
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <CGAL/Min_sphere_of_spheres_d.h>
+#include <CGAL/point_generators_3.h>
+#include <CGAL/convex_hull_3.h>
+#include <Euclid/Geometry/MeshHelpers.h>
+#include <Euclid/Geometry/PrimitiveGenerator.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+enum class _ViewSphereType
+{
+    subdiv,
+    random,
+    fibonacci
+};
+
+// Compute the minimum bounding sphere of a mesh
+template<typename Mesh, typename Point_3, typename FT>
+void _bounding_sphere(const Mesh& mesh, Point_3& center, FT& radius)
+{
+    using Kernel = typename CGAL::Kernel_traits<Point_3>::Kernel;
+    using MSTraits = CGAL::Min_sphere_of_spheres_d_traits_3<Kernel, FT>;
+    using Min_sphere = CGAL::Min_sphere_of_spheres_d<MSTraits>;
+    using Sphere = typename Min_sphere::Sphere;
+
+    auto mesh_vpmap = get(boost::vertex_point, mesh);
+    std::vector<Sphere> spheres;
+    spheres.reserve(num_vertices(mesh));
+    for (const auto& v : vertices(mesh)) {
+        spheres.emplace_back(mesh_vpmap[v], 0.0f);
+    }
+    Min_sphere ms(spheres.begin(), spheres.end());
+
+    radius = ms.radius();
+    auto iter = ms.center_cartesian_begin();
+    center = Point_3(*iter, *(iter + 1), *(iter + 2));
+}
+
+// Build a unit view sphere centered at the origin
+template<typename Mesh>
+void _build_unit_sphere(Mesh& mesh, _ViewSphereType type, int resolution)
+{
+    using Point_3 = typename boost::property_traits<
+        typename boost::property_map<Mesh,
+                                     boost::vertex_point_t>::type>::value_type;
+    using FT = typename CGAL::Kernel_traits<Point_3>::Kernel::FT;
+
+    switch (type) {
+    case _ViewSphereType::subdiv: {
+        std::vector<FT> positions;
+        std::vector<unsigned> indices;
+        make_icosphere(positions, indices, resolution);
+        make_mesh<3>(mesh, positions, indices);
+        break;
+    }
+    case _ViewSphereType::random: {
+        auto generator = CGAL::Random_points_on_sphere_3<Point_3>(1.0);
+        std::vector<Point_3> points(resolution);
+        std::copy_n(generator, resolution, points.begin());
+        CGAL::convex_hull_3(points.begin(), points.end(), mesh);
+        break;
+    }
+    case _ViewSphereType::fibonacci: {
+        const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+        std::vector<Point_3> points;
+        points.reserve(resolution);
+        for (int i = 0; i < resolution; ++i) {
+            auto z = 1.0 - (2.0 * i + 1.0) / resolution;
+            auto r = std::sqrt(1.0 - z * z);
+            auto phi = golden_angle * i;
+            points.emplace_back(r * std::cos(phi), r * std::sin(phi), z);
+        }
+        CGAL::convex_hull_3(points.begin(), points.end(), mesh);
+        break;
+    }
+    }
+}
+
+// Return the shared unit view sphere of the given type and resolution,
+// which is generated on first request
+template<typename Mesh>
+std::shared_ptr<const Mesh> _unit_sphere(_ViewSphereType type, int resolution)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<_ViewSphereType, int>,
+                    std::shared_ptr<const Mesh>>
+        templates;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& unit_sphere = templates[std::make_pair(type, resolution)];
+    if (!unit_sphere) {
+        auto mesh = std::make_shared<Mesh>();
+        _build_unit_sphere(*mesh, type, resolution);
+        unit_sphere = std::move(mesh);
+    }
+    return unit_sphere;
+}
+
+// Fit a unit view sphere around the mesh
+template<typename Mesh>
+ViewSphere<Mesh> _make_view_sphere(const Mesh& mesh,
+                                   float scale,
+                                   _ViewSphereType type,
+                                   int resolution)
+{
+    ViewSphere<Mesh> result;
+    _bounding_sphere(mesh, result.center, result.radius);
+    result.radius *= scale;
+
+    result.mesh = *_unit_sphere<Mesh>(type, resolution);
+    auto vpmap = get(boost::vertex_point, result.mesh);
+    auto offset = result.center - CGAL::ORIGIN;
+    for (const auto& v : vertices(result.mesh)) {
+        put(vpmap,
+            v,
+            CGAL::ORIGIN + (get(vpmap, v) - CGAL::ORIGIN) * result.radius +
+                offset);
+    }
+    return result;
+}
+
+} // namespace _impl
+
+template<typename Mesh>
+ViewSphere<Mesh> ViewSphere<Mesh>::make_subdiv(const Mesh& mesh,
+                                               float scale,
+                                               int subdiv)
+{
+    return _impl::_make_view_sphere(
+        mesh, scale, _impl::_ViewSphereType::subdiv, subdiv);
+}
+
+template<typename Mesh>
+ViewSphere<Mesh> ViewSphere<Mesh>::make_random(const Mesh& mesh,
+                                               float scale,
+                                               int samples)
+{
+    return _impl::_make_view_sphere(
+        mesh, scale, _impl::_ViewSphereType::random, samples);
+}
+
+template<typename Mesh>
+ViewSphere<Mesh> ViewSphere<Mesh>::make_fibonacci(const Mesh& mesh,
+                                                  float scale,
+                                                  int samples)
+{
+    return _impl::_make_view_sphere(
+        mesh, scale, _impl::_ViewSphereType::fibonacci, samples);
+}
+
+} // namespace Euclid
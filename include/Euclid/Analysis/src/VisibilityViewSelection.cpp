@@ -0,0 +1,184 @@
+#include <algorithm>
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <Eigen/Dense>
+#include <Euclid/Geometry/MeshHelpers.h>
+#include <Euclid/Math/Vector.h>
+#include <Euclid/Render/RayTracer.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Extract the mesh into buffers and compute the face areas
+template<typename Mesh>
+void _visibility_setup(const Mesh& mesh,
+                       std::vector<float>& positions,
+                       std::vector<unsigned>& indices,
+                       std::vector<float>& face_areas)
+{
+    extract_mesh<3>(mesh, positions, indices);
+    face_areas.resize(indices.size() / 3);
+    for (size_t i = 0; i < face_areas.size(); ++i) {
+        Eigen::Map<const Eigen::Vector3f> p0(&positions[3 * indices[3 * i]]);
+        Eigen::Map<const Eigen::Vector3f> p1(
+            &positions[3 * indices[3 * i + 1]]);
+        Eigen::Map<const Eigen::Vector3f> p2(
+            &positions[3 * indices[3 * i + 2]]);
+        face_areas[i] = 0.5f * (p1 - p0).cross(p2 - p0).norm();
+    }
+}
+
+// Measure the view quality of a face index image of the given number of
+// pixels, which is sorted in place
+inline float _visibility_score(unsigned* face_ids,
+                               size_t pixels,
+                               const std::vector<float>& face_areas,
+                               float total_area,
+                               ViewMeasure measure)
+{
+    // Background pixels hold RTC_INVALID_GEOMETRY_ID thus are sorted to last
+    const auto end = face_ids + pixels;
+    std::sort(face_ids, end);
+
+    auto score = 0.0f;
+    auto inv_pixels = 1.0f / pixels;
+    auto first = face_ids;
+    while (first != end) {
+        auto last = std::upper_bound(first, end, *first);
+        if (measure == ViewMeasure::visible_area) {
+            if (*first != RTC_INVALID_GEOMETRY_ID) {
+                score += face_areas[*first];
+            }
+        }
+        else { // measure == ViewMeasure::viewpoint_entropy
+            auto p = (last - first) * inv_pixels;
+            score -= p * std::log2(p);
+        }
+        first = last;
+    }
+    if (measure == ViewMeasure::visible_area) { score /= total_area; }
+    return score;
+}
+
+// Score views at viewpoints looking at the center, the bounding sphere of the
+// mesh is kept inside the view frustum. The views are rendered in batches,
+// each in a single pass over the tiles of all its views, which bounds the
+// memory of the face index images.
+inline void _visibility_scores(RayTracer& raytracer,
+                               const std::vector<float>& face_areas,
+                               const std::vector<Eigen::Vector3f>& viewpoints,
+                               const Eigen::Vector3f& center,
+                               float radius,
+                               ViewMeasure measure,
+                               int resolution,
+                               std::vector<float>& scores)
+{
+    const int batch_size = 256;
+    auto total_area = 0.0f;
+    for (auto area : face_areas) {
+        total_area += area;
+    }
+
+    const auto n = static_cast<int>(viewpoints.size());
+    const size_t pixels = static_cast<size_t>(resolution) * resolution;
+    scores.resize(n);
+    std::vector<PerspectiveCamera> cameras;
+    std::vector<unsigned> face_ids;
+    for (int first = 0; first < n; first += batch_size) {
+        const auto last = std::min(n, first + batch_size);
+        cameras.clear();
+        for (int i = first; i < last; ++i) {
+            Eigen::Vector3f view = viewpoints[i] - center;
+            auto distance = view.norm();
+            Eigen::Vector3f up(0.0f, 1.0f, 0.0f);
+            if (std::abs(view.normalized().dot(up)) > 0.99f) {
+                up = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
+            }
+            auto vfov =
+                2.0f * std::asin(std::min(radius / distance, 1.0f)) * 180.0f /
+                static_cast<float>(M_PI);
+            cameras.emplace_back(viewpoints[i], center, up, vfov);
+        }
+
+        face_ids.resize(cameras.size() * pixels);
+        raytracer.render_views(face_ids.data(),
+                               cameras,
+                               resolution,
+                               resolution,
+                               RenderMode::face_id);
+        for (int i = first; i < last; ++i) {
+            auto image = face_ids.data() + (i - first) * pixels;
+            scores[i] = _visibility_score(
+                image, pixels, face_areas, total_area, measure);
+        }
+    }
+}
+
+} // namespace _impl
+
+template<typename Mesh, typename T>
+void visibility_view_selection(const Mesh& mesh,
+                               const ViewSphere<Mesh>& view_sphere,
+                               std::vector<T>& view_scores,
+                               ViewMeasure measure,
+                               int resolution)
+{
+    std::vector<int> views(num_vertices(view_sphere.mesh));
+    for (size_t i = 0; i < views.size(); ++i) {
+        views[i] = static_cast<int>(i);
+    }
+    visibility_view_selection(
+        mesh, view_sphere, views, view_scores, measure, resolution);
+}
+
+template<typename Mesh, typename T>
+void visibility_view_selection(const Mesh& mesh,
+                               const ViewSphere<Mesh>& view_sphere,
+                               const std::vector<int>& views,
+                               std::vector<T>& view_scores,
+                               ViewMeasure measure,
+                               int resolution)
+{
+    using Point_3 = typename ViewSphere<Mesh>::Point_3;
+    using FT = typename ViewSphere<Mesh>::FT;
+
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    std::vector<float> face_areas;
+    _impl::_visibility_setup(mesh, positions, indices, face_areas);
+    RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+
+    Point_3 center;
+    FT radius;
+    _impl::_bounding_sphere(mesh, center, radius);
+
+    std::vector<Point_3> sphere_points(num_vertices(view_sphere.mesh));
+    auto sphere_vpmap = get(boost::vertex_point, view_sphere.mesh);
+    auto sphere_vimap = get(boost::vertex_index, view_sphere.mesh);
+    for (const auto& v : vertices(view_sphere.mesh)) {
+        sphere_points[sphere_vimap[v]] = sphere_vpmap[v];
+    }
+    std::vector<Eigen::Vector3f> viewpoints;
+    viewpoints.reserve(views.size());
+    for (auto v : views) {
+        viewpoints.push_back(cgal_to_eigen<float>(sphere_points[v]));
+    }
+
+    std::vector<float> scores;
+    _impl::_visibility_scores(raytracer,
+                              face_areas,
+                              viewpoints,
+                              cgal_to_eigen<float>(center),
+                              static_cast<float>(radius),
+                              measure,
+                              resolution,
+                              scores);
+    view_scores.assign(scores.begin(), scores.end());
+}
+
+} // namespace Euclid
@@ -0,0 +1,190 @@
+/** k-d tree of points.
+ *
+ *  Neighbor search is the basic operation of most point cloud algorithms.
+ *  This package contains a static k-d tree for 3D points, which stores the
+ *  coordinates of the points contiguously by leaf and answers queries
+ *  without allocating memory.
+ *  @defgroup PkgKdTree k-d Tree
+ *  @ingroup PkgGeometry
+ */
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace Euclid
+{
+/** @{*/
+
+/** A static k-d tree of 3D points.
+ *
+ *  The tree splits at the median of the widest dimension until there are at
+ *  most leaf_size points in a node, subtrees are built in parallel. The
+ *  points are reordered so that each leaf is a contiguous range of
+ *  coordinate arrays, one per dimension, which the queries scan linearly.
+ *
+ *  Queries are const and could run concurrently, each thread passing its
+ *  own Context. Results are sorted by increasing distance, ties by index.
+ *
+ *  @tparam FT Coordinate type.
+ */
+template<typename FT>
+class KdTree
+{
+public:
+    /** Buffers of queries.
+     *
+     *  A context grows to the size the queries need and is then reused, so
+     *  that queries do not allocate. A context must not be shared between
+     *  threads.
+     */
+    class Context
+    {
+    private:
+        friend class KdTree;
+        std::vector<std::pair<int, FT>> _stack;
+        std::vector<std::pair<FT, int>> _results;
+        std::vector<FT> _distances;
+    };
+
+public:
+    /** Create an empty tree.*/
+    KdTree() = default;
+
+    /** Build the tree of a positions buffer.
+     *
+     *  @param positions The point positions, [x, y, z, x, y, z, ...].
+     *  @param leaf_size Maximum number of points in a leaf.
+     */
+    explicit KdTree(const std::vector<FT>& positions, int leaf_size = 16);
+
+    /** Build the tree of a range of points.
+     *
+     *  @param first Iterator to the first point.
+     *  @param beyond Past-the-end iterator of the points.
+     *  @param point_pmap Property map of the point positions.
+     *  @param leaf_size Maximum number of points in a leaf.
+     */
+    template<typename ForwardIterator, typename PPMap>
+    KdTree(ForwardIterator first,
+           ForwardIterator beyond,
+           PPMap point_pmap,
+           int leaf_size = 16);
+
+    /** Number of points.*/
+    int size() const;
+
+    /** Find the k nearest points.
+     *
+     *  @param query Query position, [x, y, z].
+     *  @param k Number of neighbors.
+     *  @param indices Output indices of the min(k, size()) nearest points,
+     *  the indices are the order of the input points.
+     *  @param distances Output Euclidean distances to the points.
+     *  @param context Query buffers of this thread.
+     */
+    void knn(const FT* query,
+             int k,
+             std::vector<int>& indices,
+             std::vector<FT>& distances,
+             Context& context) const;
+
+    /** Find the points within a radius.
+     *
+     *  @param query Query position, [x, y, z].
+     *  @param radius Search radius, inclusive.
+     *  @param indices Output indices of the points.
+     *  @param distances Output Euclidean distances to the points.
+     *  @param context Query buffers of this thread.
+     */
+    void radius(const FT* query,
+                FT radius,
+                std::vector<int>& indices,
+                std::vector<FT>& distances,
+                Context& context) const;
+
+    /** Find the k nearest points of many queries in parallel.
+     *
+     *  @param queries Query positions, [x, y, z, x, y, z, ...].
+     *  @param n Number of queries.
+     *  @param k Number of neighbors.
+     *  @param indices Output n x k indices in row major order. If there are
+     *  fewer than k points, the rows are padded with -1.
+     *  @param distances Output n x k distances, padded with infinity.
+     */
+    void batch_knn(const FT* queries,
+                   int n,
+                   int k,
+                   int* indices,
+                   FT* distances) const;
+
+    /** Find the points within a radius of many queries in parallel.
+     *
+     *  The results are in compressed sparse rows, the neighbors of query i
+     *  are indices[offsets[i]], ..., indices[offsets[i + 1] - 1].
+     *
+     *  @param queries Query positions, [x, y, z, x, y, z, ...].
+     *  @param n Number of queries.
+     *  @param radius Search radius, inclusive.
+     *  @param offsets Output n + 1 row offsets.
+     *  @param indices Output indices of the points.
+     *  @param distances Output Euclidean distances to the points.
+     */
+    void batch_radius(const FT* queries,
+                      int n,
+                      FT radius,
+                      std::vector<int>& offsets,
+                      std::vector<int>& indices,
+                      std::vector<FT>& distances) const;
+
+private:
+    // Leaves have axis -1, the left child of a node follows it
+    struct _Node
+    {
+        FT split;
+        int axis;
+        int begin;
+        int end;
+        int right;
+    };
+
+    void _build(const std::vector<FT>& positions);
+
+    void _build_node(int* order,
+                     const FT* positions,
+                     int node,
+                     int begin,
+                     int end);
+
+    int _node_count(int count) const;
+
+    // Visit the leaves which could contain points closer than the bound,
+    // leaf(begin, end) returns the updated squared distance bound
+    template<typename Leaf>
+    void _search(const FT* query,
+                 FT bound,
+                 Context& context,
+                 Leaf&& leaf) const;
+
+    // Squared distances to the points of a leaf
+    void _leaf_distances(const FT* query,
+                         const _Node& node,
+                         Context& context) const;
+
+    static void _write_results(Context& context,
+                               std::vector<int>& indices,
+                               std::vector<FT>& distances);
+
+private:
+    int _leaf_size = 16;
+    std::vector<_Node> _nodes;
+    std::vector<FT> _x;
+    std::vector<FT> _y;
+    std::vector<FT> _z;
+    std::vector<int> _indices;
+};
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/KdTree.cpp"
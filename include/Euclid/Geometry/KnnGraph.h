@@ -0,0 +1,96 @@
+/** Neighborhood graphs of point clouds.
+ *
+ *  Most point cloud algorithms, e.g. normal estimation, laplacians,
+ *  filtering and segmentation, work on the neighbors of each point. This
+ *  package finds the neighbors of all points at once, in parallel, and
+ *  stores them in flat arrays instead of one container per point.
+ *  @defgroup PkgKnnGraph kNN Graph
+ *  @ingroup PkgGeometry
+ */
+#pragma once
+
+#include <vector>
+
+#include <Euclid/Geometry/KdTree.h>
+
+namespace Euclid
+{
+/** @{*/
+
+/** Neighborhood graph of a point cloud.
+ *
+ *  The graph is stored in compressed sparse rows, the neighbors of point i
+ *  are neighbors[offsets[i]], ..., neighbors[offsets[i + 1] - 1], with their
+ *  distances to point i in the same positions of distances. Points are
+ *  indexed in the order of the input range, each row is sorted by increasing
+ *  distance and a point is never a neighbor of itself.
+ *  For k nearest neighbors without symmetrization, all rows have exactly k
+ *  entries, so the arrays are n x k matrices in row major order.
+ */
+template<typename FT>
+struct KnnGraph
+{
+    /** Start of the row of each point, plus the total size at the end.*/
+    std::vector<int> offsets;
+
+    /** Indices of the neighbors.*/
+    std::vector<int> neighbors;
+
+    /** Euclidean distances to the neighbors.*/
+    std::vector<FT> distances;
+
+    /** Number of points.*/
+    int size() const;
+
+    /** Number of neighbors of point i.*/
+    int degree(int i) const;
+};
+
+/** Build the k nearest neighbor graph of a point cloud.
+ *
+ *  All points are queried in parallel.
+ *
+ *  @param first Iterator to the first point.
+ *  @param beyond Past-the-end iterator of the points.
+ *  @param point_pmap Property map of the point positions.
+ *  @param k Number of neighbors of each point, clamped to the number of
+ *  points minus one.
+ *  @param graph Output graph.
+ *  @param symmetric If true, j is also a neighbor of i whenever i is a
+ *  neighbor of j, so the rows could have more than k entries.
+ */
+template<typename ForwardIterator, typename PPMap, typename FT>
+void knn_graph(ForwardIterator first,
+               ForwardIterator beyond,
+               PPMap point_pmap,
+               int k,
+               KnnGraph<FT>& graph,
+               bool symmetric = false);
+
+/** Build the fixed radius neighbor graph of a point cloud.
+ *
+ *  All points are queried in parallel.
+ *
+ *  @param first Iterator to the first point.
+ *  @param beyond Past-the-end iterator of the points.
+ *  @param point_pmap Property map of the point positions.
+ *  @param radius Neighbors are within this distance.
+ *  @param graph Output graph.
+ *  @param k If positive, only the k nearest neighbors within the radius are
+ *  kept, which bounds the size of the graph in dense regions.
+ *  @param symmetric If true, j is also a neighbor of i whenever i is a
+ *  neighbor of j, which only matters when k is positive.
+ */
+template<typename ForwardIterator, typename PPMap, typename FT>
+void radius_graph(ForwardIterator first,
+                  ForwardIterator beyond,
+                  PPMap point_pmap,
+                  double radius,
+                  KnnGraph<FT>& graph,
+                  int k = 0,
+                  bool symmetric = false);
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/KnnGraph.cpp"
@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <vector>
 #include <CGAL/boost/graph/helpers.h>
 
 namespace Euclid
@@ -27,6 +28,24 @@ void make_subdivision_sphere(
     typename CGAL::Kernel_traits<Point_3>::Kernel::FT radius = 1.0,
     int iterations = 4);
 
+/** Create a unit icosphere.
+ *
+ *  Create a unit sphere centered at the origin by repeatedly splitting each
+ *  triangle of an icosahedron into four and projecting the edge midpoints
+ *  onto the sphere. Unlike make_subdivision_sphere(), no mesh data structure
+ *  is involved and the vertices of a coarser level keep their positions and
+ *  indices in all finer levels, i.e. the first n vertices of level i + 1 are
+ *  exactly the n vertices of level i.
+ *
+ *  @param positions Output positions buffer.
+ *  @param indices Output triangle indices buffer.
+ *  @param iterations The iterations of subdivision.
+ */
+template<typename FT, typename IT>
+void make_icosphere(std::vector<FT>& positions,
+                    std::vector<IT>& indices,
+                    int iterations = 4);
+
 /** @}*/
 } // namespace Euclid
 
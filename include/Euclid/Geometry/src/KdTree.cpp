@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include <boost/property_map/property_map.hpp>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Copy the positions of a range of points into [x, y, z, x, y, z, ...]
+template<typename FT, typename ForwardIterator, typename PPMap>
+std::vector<FT> _point_positions(ForwardIterator first,
+                                 ForwardIterator beyond,
+                                 PPMap point_pmap)
+{
+    std::vector<FT> positions;
+    for (auto iter = first; iter != beyond; ++iter) {
+        const auto& p = get(point_pmap, *iter);
+        positions.push_back(static_cast<FT>(p.x()));
+        positions.push_back(static_cast<FT>(p.y()));
+        positions.push_back(static_cast<FT>(p.z()));
+    }
+    return positions;
+}
+
+// Subtrees larger than this are built as separate tasks
+constexpr int _kd_tree_task_size = 1 << 14;
+
+} // namespace _impl
+
+template<typename FT>
+KdTree<FT>::KdTree(const std::vector<FT>& positions, int leaf_size)
+    : _leaf_size(leaf_size)
+{
+    _build(positions);
+}
+
+template<typename FT>
+template<typename ForwardIterator, typename PPMap>
+KdTree<FT>::KdTree(ForwardIterator first,
+                   ForwardIterator beyond,
+                   PPMap point_pmap,
+                   int leaf_size)
+    : _leaf_size(leaf_size)
+{
+    _build(_impl::_point_positions<FT>(first, beyond, point_pmap));
+}
+
+template<typename FT>
+int KdTree<FT>::size() const
+{
+    return static_cast<int>(_indices.size());
+}
+
+template<typename FT>
+void KdTree<FT>::knn(const FT* query,
+                     int k,
+                     std::vector<int>& indices,
+                     std::vector<FT>& distances,
+                     Context& context) const
+{
+    // A max heap of the k nearest points found so far
+    auto& heap = context._results;
+    heap.clear();
+    if (k > 0 && !_nodes.empty()) {
+        const auto inf = std::numeric_limits<FT>::infinity();
+        _search(query, inf, context, [&](const _Node& node) {
+            _leaf_distances(query, node, context);
+            for (int s = node.begin; s < node.end; ++s) {
+                const std::pair<FT, int> entry(
+                    context._distances[s - node.begin], _indices[s]);
+                if (static_cast<int>(heap.size()) < k) {
+                    heap.push_back(entry);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+                else if (entry < heap.front()) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = entry;
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            return static_cast<int>(heap.size()) < k ? inf
+                                                      : heap.front().first;
+        });
+        std::sort_heap(heap.begin(), heap.end());
+    }
+    _write_results(context, indices, distances);
+}
+
+template<typename FT>
+void KdTree<FT>::radius(const FT* query,
+                        FT radius,
+                        std::vector<int>& indices,
+                        std::vector<FT>& distances,
+                        Context& context) const
+{
+    auto& results = context._results;
+    results.clear();
+    if (radius >= 0 && !_nodes.empty()) {
+        const FT bound = radius * radius;
+        _search(query, bound, context, [&](const _Node& node) {
+            _leaf_distances(query, node, context);
+            for (int s = node.begin; s < node.end; ++s) {
+                const auto d = context._distances[s - node.begin];
+                if (d <= bound) { results.emplace_back(d, _indices[s]); }
+            }
+            return bound;
+        });
+        std::sort(results.begin(), results.end());
+    }
+    _write_results(context, indices, distances);
+}
+
+template<typename FT>
+void KdTree<FT>::batch_knn(const FT* queries,
+                           int n,
+                           int k,
+                           int* indices,
+                           FT* distances) const
+{
+    if (k <= 0) { return; }
+#pragma omp parallel
+    {
+        Context context;
+        std::vector<int> row_indices;
+        std::vector<FT> row_distances;
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < n; ++i) {
+            knn(queries + 3 * i, k, row_indices, row_distances, context);
+            const auto offset = static_cast<size_t>(i) * k;
+            const int count = static_cast<int>(row_indices.size());
+            for (int j = 0; j < count; ++j) {
+                indices[offset + j] = row_indices[j];
+                distances[offset + j] = row_distances[j];
+            }
+            for (int j = count; j < k; ++j) {
+                indices[offset + j] = -1;
+                distances[offset + j] = std::numeric_limits<FT>::infinity();
+            }
+        }
+    }
+}
+
+template<typename FT>
+void KdTree<FT>::batch_radius(const FT* queries,
+                              int n,
+                              FT radius,
+                              std::vector<int>& offsets,
+                              std::vector<int>& indices,
+                              std::vector<FT>& distances) const
+{
+    // Queries are processed in blocks, each with its own buffers, which are
+    // concatenated at the end
+    const int block_size = 1024;
+    const int blocks = (n + block_size - 1) / block_size;
+    std::vector<std::vector<int>> block_indices(blocks);
+    std::vector<std::vector<FT>> block_distances(blocks);
+    offsets.assign(n + 1, 0);
+
+#pragma omp parallel
+    {
+        Context context;
+        std::vector<int> row_indices;
+        std::vector<FT> row_distances;
+#pragma omp for schedule(dynamic)
+        for (int b = 0; b < blocks; ++b) {
+            const int last = std::min(n, (b + 1) * block_size);
+            for (int i = b * block_size; i < last; ++i) {
+                this->radius(queries + 3 * i,
+                             radius,
+                             row_indices,
+                             row_distances,
+                             context);
+                block_indices[b].insert(block_indices[b].end(),
+                                        row_indices.begin(),
+                                        row_indices.end());
+                block_distances[b].insert(block_distances[b].end(),
+                                          row_distances.begin(),
+                                          row_distances.end());
+                offsets[i + 1] = static_cast<int>(row_indices.size());
+            }
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    indices.resize(offsets[n]);
+    distances.resize(offsets[n]);
+#pragma omp parallel for
+    for (int b = 0; b < blocks; ++b) {
+        const auto offset = offsets[b * block_size];
+        std::copy(block_indices[b].begin(),
+                  block_indices[b].end(),
+                  indices.begin() + offset);
+        std::copy(block_distances[b].begin(),
+                  block_distances[b].end(),
+                  distances.begin() + offset);
+    }
+}
+
+template<typename FT>
+void KdTree<FT>::_build(const std::vector<FT>& positions)
+{
+    if (_leaf_size <= 0) {
+        throw std::invalid_argument("Leaf size must be positive.");
+    }
+    if (positions.size() % 3 != 0) {
+        throw std::invalid_argument(
+            "Size of positions must be a multiple of 3.");
+    }
+    const int n = static_cast<int>(positions.size() / 3);
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    if (n > 0) {
+        _nodes.resize(_node_count(n));
+#pragma omp parallel
+#pragma omp single
+        _build_node(order.data(), positions.data(), 0, 0, n);
+    }
+
+    // Gather the coordinates in the order of the leaves
+    _x.resize(n);
+    _y.resize(n);
+    _z.resize(n);
+#pragma omp parallel for
+    for (int s = 0; s < n; ++s) {
+        _x[s] = positions[3 * order[s] + 0];
+        _y[s] = positions[3 * order[s] + 1];
+        _z[s] = positions[3 * order[s] + 2];
+    }
+    _indices = std::move(order);
+}
+
+template<typename FT>
+void KdTree<FT>::_build_node(int* order,
+                             const FT* positions,
+                             int node,
+                             int begin,
+                             int end)
+{
+    auto& current = _nodes[node];
+    current.split = FT(0);
+    current.axis = -1;
+    current.begin = begin;
+    current.end = end;
+    current.right = -1;
+    if (end - begin <= _leaf_size) { return; }
+
+    // Split the widest dimension at the median
+    FT lower[3];
+    FT upper[3];
+    for (int c = 0; c < 3; ++c) {
+        lower[c] = upper[c] = positions[3 * order[begin] + c];
+    }
+    for (int i = begin + 1; i < end; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            const auto value = positions[3 * order[i] + c];
+            lower[c] = std::min(lower[c], value);
+            upper[c] = std::max(upper[c], value);
+        }
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (upper[c] - lower[c] > upper[axis] - lower[axis]) { axis = c; }
+    }
+    const int mid = begin + (end - begin) / 2;
+    std::nth_element(
+        order + begin, order + mid, order + end, [=](int lhs, int rhs) {
+            return positions[3 * lhs + axis] < positions[3 * rhs + axis];
+        });
+    current.split = positions[3 * order[mid] + axis];
+    current.axis = axis;
+    // The node count of a subtree only depends on its size, so the right
+    // child is known before the left subtree is built
+    current.right = node + 1 + _node_count(mid - begin);
+
+    const int right = current.right;
+    if (end - begin >= _impl::_kd_tree_task_size) {
+#pragma omp task
+        _build_node(order, positions, node + 1, begin, mid);
+        _build_node(order, positions, right, mid, end);
+#pragma omp taskwait
+    }
+    else {
+        _build_node(order, positions, node + 1, begin, mid);
+        _build_node(order, positions, right, mid, end);
+    }
+}
+
+template<typename FT>
+int KdTree<FT>::_node_count(int count) const
+{
+    if (count <= _leaf_size) { return 1; }
+    return 1 + _node_count(count / 2) + _node_count(count - count / 2);
+}
+
+template<typename FT>
+template<typename Leaf>
+void KdTree<FT>::_search(const FT* query,
+                         FT bound,
+                         Context& context,
+                         Leaf&& leaf) const
+{
+    // Nodes to visit with lower bounds of their squared distances
+    auto& stack = context._stack;
+    stack.clear();
+    stack.emplace_back(0, FT(0));
+    while (!stack.empty()) {
+        const auto [index, lower] = stack.back();
+        stack.pop_back();
+        if (lower > bound) { continue; }
+        const auto& node = _nodes[index];
+        if (node.axis < 0) {
+            bound = leaf(node);
+            continue;
+        }
+        // Points on the other side are at least as far as the plane
+        const FT diff = query[node.axis] - node.split;
+        const int near = diff < 0 ? index + 1 : node.right;
+        const int far = diff < 0 ? node.right : index + 1;
+        stack.emplace_back(far, std::max(lower, diff * diff));
+        stack.emplace_back(near, lower);
+    }
+}
+
+template<typename FT>
+void KdTree<FT>::_leaf_distances(const FT* query,
+                                 const _Node& node,
+                                 Context& context) const
+{
+    if (static_cast<int>(context._distances.size()) < _leaf_size) {
+        context._distances.resize(_leaf_size);
+    }
+    // A plain loop over the coordinate arrays, which compilers vectorize
+    const FT qx = query[0];
+    const FT qy = query[1];
+    const FT qz = query[2];
+    const FT* x = _x.data() + node.begin;
+    const FT* y = _y.data() + node.begin;
+    const FT* z = _z.data() + node.begin;
+    FT* d = context._distances.data();
+    const int count = node.end - node.begin;
+    for (int i = 0; i < count; ++i) {
+        const FT dx = x[i] - qx;
+        const FT dy = y[i] - qy;
+        const FT dz = z[i] - qz;
+        d[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+template<typename FT>
+void KdTree<FT>::_write_results(Context& context,
+                                std::vector<int>& indices,
+                                std::vector<FT>& distances)
+{
+    const auto& results = context._results;
+    indices.resize(results.size());
+    distances.resize(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        indices[i] = results[i].second;
+        distances[i] = std::sqrt(results[i].first);
+    }
+}
+
+} // namespace Euclid
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Query buffers of a thread
+template<typename FT>
+struct _KnnScratch
+{
+    typename KdTree<FT>::Context context;
+    std::vector<int> indices;
+    std::vector<FT> distances;
+};
+
+// Fill in the rows of a graph of n points in parallel, where
+// row(i, entries, scratch) appends the (distance, index) of the neighbors of
+// point i. Each row is sorted and its duplicates are removed. Points are
+// processed in blocks, each with its own buffers, which are concatenated at
+// the end, so there are few allocations however large the graph is.
+template<typename FT, typename Row>
+void _gather_rows(int n, Row row, KnnGraph<FT>& graph)
+{
+    using Entry = std::pair<FT, int>;
+    const int block_size = 1024;
+    const int blocks = (n + block_size - 1) / block_size;
+    std::vector<std::vector<int>> block_neighbors(blocks);
+    std::vector<std::vector<FT>> block_distances(blocks);
+    graph.offsets.assign(n + 1, 0);
+    auto by_index = [](const Entry& lhs, const Entry& rhs) {
+        return lhs.second < rhs.second;
+    };
+    auto same_index = [](const Entry& lhs, const Entry& rhs) {
+        return lhs.second == rhs.second;
+    };
+
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < blocks; ++b) {
+        std::vector<Entry> entries;
+        _KnnScratch<FT> scratch;
+        const int last = std::min(n, (b + 1) * block_size);
+        for (int i = b * block_size; i < last; ++i) {
+            entries.clear();
+            row(i, entries, scratch);
+            std::sort(entries.begin(), entries.end(), by_index);
+            auto end = std::unique(entries.begin(), entries.end(), same_index);
+            std::sort(entries.begin(), end);
+            for (auto it = entries.begin(); it != end; ++it) {
+                block_distances[b].push_back(it->first);
+                block_neighbors[b].push_back(it->second);
+            }
+            graph.offsets[i + 1] = static_cast<int>(end - entries.begin());
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        graph.offsets[i + 1] += graph.offsets[i];
+    }
+    graph.neighbors.resize(graph.offsets[n]);
+    graph.distances.resize(graph.offsets[n]);
+#pragma omp parallel for
+    for (int b = 0; b < blocks; ++b) {
+        const auto offset = graph.offsets[b * block_size];
+        std::copy(block_neighbors[b].begin(),
+                  block_neighbors[b].end(),
+                  graph.neighbors.begin() + offset);
+        std::copy(block_distances[b].begin(),
+                  block_distances[b].end(),
+                  graph.distances.begin() + offset);
+    }
+}
+
+// Add the reverse of every edge
+template<typename FT>
+void _symmetrize(KnnGraph<FT>& graph)
+{
+    const int n = graph.size();
+
+    // Transpose by counting sort
+    std::vector<int> offsets(n + 1, 0);
+    std::vector<int> sources(graph.neighbors.size());
+    std::vector<FT> distances(graph.distances.size());
+    for (auto j : graph.neighbors) {
+        ++offsets[j + 1];
+    }
+    for (int i = 0; i < n; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<int> positions(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        for (int e = graph.offsets[i]; e < graph.offsets[i + 1]; ++e) {
+            const auto position = positions[graph.neighbors[e]]++;
+            sources[position] = i;
+            distances[position] = graph.distances[e];
+        }
+    }
+
+    // Mutual neighbors appear twice, which are merged
+    const KnnGraph<FT> directed = std::move(graph);
+    _gather_rows(
+        n,
+        [&](int i, auto& entries, auto&) {
+            for (int e = directed.offsets[i]; e < directed.offsets[i + 1];
+                 ++e) {
+                entries.emplace_back(directed.distances[e],
+                                     directed.neighbors[e]);
+            }
+            for (int e = offsets[i]; e < offsets[i + 1]; ++e) {
+                entries.emplace_back(distances[e], sources[e]);
+            }
+        },
+        graph);
+}
+
+} // namespace _impl
+
+template<typename FT>
+int KnnGraph<FT>::size() const
+{
+    return offsets.empty() ? 0 : static_cast<int>(offsets.size()) - 1;
+}
+
+template<typename FT>
+int KnnGraph<FT>::degree(int i) const
+{
+    return offsets[i + 1] - offsets[i];
+}
+
+template<typename ForwardIterator, typename PPMap, typename FT>
+void knn_graph(ForwardIterator first,
+               ForwardIterator beyond,
+               PPMap point_pmap,
+               int k,
+               KnnGraph<FT>& graph,
+               bool symmetric)
+{
+    if (k <= 0) {
+        throw std::invalid_argument("Number of neighbors must be positive.");
+    }
+    const auto positions =
+        _impl::_point_positions<FT>(first, beyond, point_pmap);
+    const int n = static_cast<int>(positions.size() / 3);
+    k = std::min(k, std::max(n - 1, 0));
+    graph.offsets.resize(n + 1);
+    graph.neighbors.assign(static_cast<size_t>(n) * k, 0);
+    graph.distances.assign(static_cast<size_t>(n) * k, FT(0));
+    for (int i = 0; i <= n; ++i) {
+        graph.offsets[i] = i * k;
+    }
+    if (k == 0) { return; }
+    const KdTree<FT> tree(positions);
+
+#pragma omp parallel
+    {
+        _impl::_KnnScratch<FT> scratch;
+#pragma omp for schedule(dynamic, 256)
+        for (int i = 0; i < n; ++i) {
+            // The point itself is usually the nearest, but a duplicate could be
+            tree.knn(positions.data() + 3 * i,
+                     k + 1,
+                     scratch.indices,
+                     scratch.distances,
+                     scratch.context);
+            // Rows have exactly k entries, written in place
+            auto offset = static_cast<size_t>(i) * k;
+            const auto end = offset + k;
+            for (size_t j = 0; j < scratch.indices.size() && offset < end;
+                 ++j) {
+                if (scratch.indices[j] == i) { continue; }
+                graph.neighbors[offset] = scratch.indices[j];
+                graph.distances[offset] = scratch.distances[j];
+                ++offset;
+            }
+        }
+    }
+
+    if (symmetric) { _impl::_symmetrize(graph); }
+}
+
+template<typename ForwardIterator, typename PPMap, typename FT>
+void radius_graph(ForwardIterator first,
+                  ForwardIterator beyond,
+                  PPMap point_pmap,
+                  double radius,
+                  KnnGraph<FT>& graph,
+                  int k,
+                  bool symmetric)
+{
+    if (!(radius >= 0.0)) {
+        throw std::invalid_argument("Radius must be non-negative.");
+    }
+    const auto positions =
+        _impl::_point_positions<FT>(first, beyond, point_pmap);
+    const int n = static_cast<int>(positions.size() / 3);
+    const auto r = static_cast<FT>(radius);
+    const KdTree<FT> tree(positions);
+    _impl::_gather_rows(
+        n,
+        [&](int i, auto& entries, auto& scratch) {
+            const auto query = positions.data() + 3 * i;
+            if (k > 0) {
+                // Nearest first, then cut at the radius
+                tree.knn(query,
+                         k + 1,
+                         scratch.indices,
+                         scratch.distances,
+                         scratch.context);
+            }
+            else {
+                tree.radius(query,
+                            r,
+                            scratch.indices,
+                            scratch.distances,
+                            scratch.context);
+            }
+            for (size_t j = 0; j < scratch.indices.size(); ++j) {
+                if (scratch.indices[j] == i) { continue; }
+                if (scratch.distances[j] > r) { break; }
+                if (k > 0 && static_cast<int>(entries.size()) == k) { break; }
+                entries.emplace_back(scratch.distances[j], scratch.indices[j]);
+            }
+        },
+        graph);
+
+    if (symmetric) { _impl::_symmetrize(graph); }
+}
+
+} // namespace Euclid
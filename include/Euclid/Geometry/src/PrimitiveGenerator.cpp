@@ -2,6 +2,10 @@
 #include <Euclid/Math/Vector.h>
 #include <CGAL/subdivision_method_3.h>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace Euclid
 {
@@ -27,4 +31,90 @@ void make_subdivision_sphere(
     }
 }
 
+template<typename FT, typename IT>
+void make_icosphere(std::vector<FT>& positions,
+                    std::vector<IT>& indices,
+                    int iterations)
+{
+    if (iterations < 0) {
+        throw std::invalid_argument("Iterations must be non-negative.");
+    }
+
+    // Work in double precision so that all levels share bit-identical
+    // vertices regardless of the output type
+    const double t = (1.0 + std::sqrt(5.0)) * 0.5;
+    std::vector<double> points{ -1.0, t,    0.0,  1.0,  t,    0.0,
+                                -1.0, -t,   0.0,  1.0,  -t,   0.0,
+                                0.0,  -1.0, t,    0.0,  1.0,  t,
+                                0.0,  -1.0, -t,   0.0,  1.0,  -t,
+                                t,    0.0,  -1.0, t,    0.0,  1.0,
+                                -t,   0.0,  -1.0, -t,   0.0,  1.0 };
+    std::vector<uint32_t> faces{ 0, 11, 5,  0, 5,  1, 0, 1, 7,  0, 7,  10,
+                                 0, 10, 11, 1, 5,  9, 5, 11, 4, 11, 10, 2,
+                                 10, 7, 6,  7, 1,  8, 3, 9,  4, 3, 4,  2,
+                                 3, 2,  6,  3, 6,  8, 3, 8,  9, 4, 9,  5,
+                                 2, 4,  11, 6, 2,  10, 8, 6, 7,  9, 8,  1 };
+    auto project = [&points](size_t i) {
+        auto x = points[3 * i + 0];
+        auto y = points[3 * i + 1];
+        auto z = points[3 * i + 2];
+        auto inv_len = 1.0 / std::sqrt(x * x + y * y + z * z);
+        points[3 * i + 0] = x * inv_len;
+        points[3 * i + 1] = y * inv_len;
+        points[3 * i + 2] = z * inv_len;
+    };
+    for (size_t i = 0; i < points.size() / 3; ++i) {
+        project(i);
+    }
+
+    for (int iter = 0; iter < iterations; ++iter) {
+        // Every edge is shared by two faces, so V' = V + E = V + 3F / 2
+        std::unordered_map<uint64_t, uint32_t> midpoints;
+        midpoints.reserve(faces.size() / 2);
+        points.reserve(points.size() + faces.size() / 2 * 3);
+        auto midpoint = [&points, &midpoints, &project](uint32_t a,
+                                                        uint32_t b) {
+            auto key = (static_cast<uint64_t>(std::min(a, b)) << 32) |
+                       std::max(a, b);
+            auto found = midpoints.find(key);
+            if (found != midpoints.end()) { return found->second; }
+
+            auto idx = static_cast<uint32_t>(points.size() / 3);
+            for (int i = 0; i < 3; ++i) {
+                points.push_back(0.5 * (points[3 * a + i] + points[3 * b + i]));
+            }
+            project(idx);
+            midpoints.emplace(key, idx);
+            return idx;
+        };
+
+        std::vector<uint32_t> subdivided;
+        subdivided.reserve(faces.size() * 4);
+        for (size_t i = 0; i < faces.size(); i += 3) {
+            auto v0 = faces[i + 0];
+            auto v1 = faces[i + 1];
+            auto v2 = faces[i + 2];
+            auto m01 = midpoint(v0, v1);
+            auto m12 = midpoint(v1, v2);
+            auto m20 = midpoint(v2, v0);
+            subdivided.insert(subdivided.end(), { v0, m01, m20 });
+            subdivided.insert(subdivided.end(), { v1, m12, m01 });
+            subdivided.insert(subdivided.end(), { v2, m20, m12 });
+            subdivided.insert(subdivided.end(), { m01, m12, m20 });
+        }
+        faces.swap(subdivided);
+    }
+
+    positions.resize(points.size());
+    std::transform(points.begin(),
+                   points.end(),
+                   positions.begin(),
+                   [](double value) { return static_cast<FT>(value); });
+    indices.resize(faces.size());
+    std::transform(faces.begin(),
+                   faces.end(),
+                   indices.begin(),
+                   [](uint32_t value) { return static_cast<IT>(value); });
+}
+
 } // namespace Euclid
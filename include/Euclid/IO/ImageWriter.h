@@ -0,0 +1,139 @@
+/** Image output.
+ *
+ *  Write rendered images to files in the background, so that the threads
+ *  producing the images do not wait for compression and disk I/O.
+ *  Images are encoded by stb_image_write, define
+ *  STB_IMAGE_WRITE_IMPLEMENTATION in exactly one source file before including
+ *  this header, or stb_image_write.h itself.
+ *  @defgroup PkgImageWriter Image Writer
+ *  @ingroup PkgIO
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Euclid
+{
+/** @{*/
+
+/** Write images on a pool of background threads.
+ *
+ *  write() converts the pixels into 8-bit interleaved rows right away, which
+ *  is cheap, and queues the image for the encoder threads. The queue is
+ *  bounded so a fast producer could not exhaust the memory, write() waits
+ *  for a free slot when the queue is full, while try_write() returns
+ *  immediately. The image format is deduced from the file extension, one of
+ *  .png, .jpg, .bmp and .tga.
+ */
+class AsyncImageWriter
+{
+public:
+    /** Create an image writer.
+     *
+     *  @param threads Number of encoder threads.
+     *  @param capacity Maximum number of images waiting to be encoded.
+     */
+    explicit AsyncImageWriter(int threads = 1, size_t capacity = 16);
+
+    /** Wait for all queued images to be written.*/
+    ~AsyncImageWriter();
+
+    AsyncImageWriter(const AsyncImageWriter&) = delete;
+
+    AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+    /** Queue an image, waiting for a free slot if the queue is full.
+     *
+     *  @param filename Output file name.
+     *  @param pixels Input pixels, which could be released once the function
+     *  returns. Values are clamped to [0, 255].
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param channels Number of channels, from 1 to 4.
+     *  @param interleaved If true, pixels are stored like [RGBRGBRGB...],
+     *  otherwise pixels are stored like [RRR...GGG...BBB...], e.g. the
+     *  layouts of RayTracer::render_shaded().
+     *  @param flip If true, rows are stored bottom up.
+     */
+    template<typename T>
+    void write(const std::string& filename,
+               const T* pixels,
+               int width,
+               int height,
+               int channels,
+               bool interleaved = true,
+               bool flip = false);
+
+    /** Queue an image if the queue is not full.
+     *
+     *  Same as write(), but never waits.
+     *
+     *  @return false if the queue is full and the image is dropped.
+     */
+    template<typename T>
+    bool try_write(const std::string& filename,
+                   const T* pixels,
+                   int width,
+                   int height,
+                   int channels,
+                   bool interleaved = true,
+                   bool flip = false);
+
+    /** Wait for all queued images to be written.
+     *
+     *  Throws std::runtime_error naming the files which could not be
+     *  written since the last call.
+     */
+    void wait();
+
+    /** Number of images queued or being written.*/
+    size_t pending();
+
+private:
+    // An image in 8-bit interleaved rows, top down
+    struct _Image
+    {
+        std::string filename;
+        std::vector<unsigned char> pixels;
+        int width;
+        int height;
+        int channels;
+    };
+
+    template<typename T>
+    static _Image _convert(const std::string& filename,
+                           const T* pixels,
+                           int width,
+                           int height,
+                           int channels,
+                           bool interleaved,
+                           bool flip);
+
+    static bool _encode(const _Image& image);
+
+    void _work();
+
+private:
+    std::vector<std::thread> _workers;
+    size_t _capacity;
+
+    // Guards the states below
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::condition_variable _idle;
+    std::deque<_Image> _queue;
+    size_t _busy = 0;
+    std::vector<std::string> _failed;
+    bool _stop = false;
+};
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/ImageWriter.cpp"
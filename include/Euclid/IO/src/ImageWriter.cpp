@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <type_traits>
+
+#include <stb_image_write.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Lower case extension of a file name, without the dot
+inline std::string _extension(const std::string& filename)
+{
+    auto dot = filename.find_last_of('.');
+    if (dot == std::string::npos) { return std::string(); }
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return ext;
+}
+
+// Bytes of any signedness are taken as unsigned, e.g. images rendered into
+// char buffers, while wider and floating point values are clamped
+template<typename T>
+unsigned char _to_byte(T value)
+{
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        return static_cast<unsigned char>(value);
+    }
+    else {
+        auto clamped = std::clamp<double>(value, 0.0, 255.0);
+        return static_cast<unsigned char>(clamped);
+    }
+}
+
+} // namespace _impl
+
+inline AsyncImageWriter::AsyncImageWriter(int threads, size_t capacity)
+    : _capacity(std::max<size_t>(capacity, 1))
+{
+    if (threads <= 0) {
+        throw std::invalid_argument("Number of threads must be positive.");
+    }
+    for (int i = 0; i < threads; ++i) {
+        _workers.emplace_back([this] { _work(); });
+    }
+}
+
+inline AsyncImageWriter::~AsyncImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _not_empty.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+template<typename T>
+void AsyncImageWriter::write(const std::string& filename,
+                             const T* pixels,
+                             int width,
+                             int height,
+                             int channels,
+                             bool interleaved,
+                             bool flip)
+{
+    auto image = _convert(
+        filename, pixels, width, height, channels, interleaved, flip);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_full.wait(lock, [this] { return _queue.size() < _capacity; });
+    _queue.push_back(std::move(image));
+    lock.unlock();
+    _not_empty.notify_one();
+}
+
+template<typename T>
+bool AsyncImageWriter::try_write(const std::string& filename,
+                                 const T* pixels,
+                                 int width,
+                                 int height,
+                                 int channels,
+                                 bool interleaved,
+                                 bool flip)
+{
+    {
+        // Do not convert images which would be dropped anyway
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.size() >= _capacity) { return false; }
+    }
+    auto image = _convert(
+        filename, pixels, width, height, channels, interleaved, flip);
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_queue.size() >= _capacity) { return false; }
+    _queue.push_back(std::move(image));
+    lock.unlock();
+    _not_empty.notify_one();
+    return true;
+}
+
+inline void AsyncImageWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _queue.empty() && _busy == 0; });
+    if (!_failed.empty()) {
+        std::string err_str("Failed to write image");
+        for (const auto& filename : _failed) {
+            err_str.append(" ");
+            err_str.append(filename);
+        }
+        _failed.clear();
+        throw std::runtime_error(err_str);
+    }
+}
+
+inline size_t AsyncImageWriter::pending()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.size() + _busy;
+}
+
+template<typename T>
+AsyncImageWriter::_Image AsyncImageWriter::_convert(const std::string& filename,
+                                                    const T* pixels,
+                                                    int width,
+                                                    int height,
+                                                    int channels,
+                                                    bool interleaved,
+                                                    bool flip)
+{
+    if (channels < 1 || channels > 4) {
+        throw std::invalid_argument("Number of channels must be in [1, 4].");
+    }
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Image size must be positive.");
+    }
+    const auto ext = _impl::_extension(filename);
+    if (ext != "png" && ext != "jpg" && ext != "jpeg" && ext != "bmp" &&
+        ext != "tga") {
+        std::string err_str("Unsupported image format ");
+        err_str.append(filename);
+        throw std::invalid_argument(err_str);
+    }
+
+    _Image image;
+    image.filename = filename;
+    image.width = width;
+    image.height = height;
+    image.channels = channels;
+    image.pixels.resize(static_cast<size_t>(width) * height * channels);
+    const size_t plane = static_cast<size_t>(width) * height;
+    for (int y = 0; y < height; ++y) {
+        const size_t src_row = flip ? height - y - 1 : y;
+        auto dst = image.pixels.data() + y * width * channels;
+        if (interleaved) {
+            auto src = pixels + src_row * width * channels;
+            for (int i = 0; i < width * channels; ++i) {
+                dst[i] = _impl::_to_byte(src[i]);
+            }
+        }
+        else {
+            for (int c = 0; c < channels; ++c) {
+                auto src = pixels + c * plane + src_row * width;
+                for (int x = 0; x < width; ++x) {
+                    dst[x * channels + c] = _impl::_to_byte(src[x]);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+inline bool AsyncImageWriter::_encode(const _Image& image)
+{
+    const auto ext = _impl::_extension(image.filename);
+    const auto name = image.filename.c_str();
+    const auto data = image.pixels.data();
+    if (ext == "png") {
+        return stbi_write_png(name,
+                              image.width,
+                              image.height,
+                              image.channels,
+                              data,
+                              image.width * image.channels) != 0;
+    }
+    if (ext == "jpg" || ext == "jpeg") {
+        return stbi_write_jpg(
+                   name, image.width, image.height, image.channels, data, 95) !=
+               0;
+    }
+    if (ext == "bmp") {
+        return stbi_write_bmp(
+                   name, image.width, image.height, image.channels, data) != 0;
+    }
+    return stbi_write_tga(
+               name, image.width, image.height, image.channels, data) != 0;
+}
+
+inline void AsyncImageWriter::_work()
+{
+    while (true) {
+        _Image image;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty.wait(lock, [this] { return _stop || !_queue.empty(); });
+            // Queued images are still written when stopping
+            if (_queue.empty()) { return; }
+            image = std::move(_queue.front());
+            _queue.pop_front();
+            ++_busy;
+        }
+        _not_full.notify_one();
+
+        const bool written = _encode(image);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_busy;
+        if (!written) { _failed.push_back(image.filename); }
+        if (_queue.empty() && _busy == 0) { _idle.notify_all(); }
+    }
+}
+
+} // namespace Euclid
@@ -0,0 +1,95 @@
+/** Post-processing of rendered images.
+ *
+ *  Renderers accumulate linear colors in floating point buffers, which are
+ *  turned into displayable images at the end of a frame. This package does
+ *  the exposure, tone mapping, gamma correction, quantization, flip and
+ *  layout conversion in a few passes over whole rows, so finalizing a frame
+ *  costs little compared to tracing it.
+ *
+ *  @defgroup PkgPostProcess Post-Process
+ *  @ingroup PkgRender
+ */
+#pragma once
+
+namespace Euclid
+{
+/** @{*/
+
+/** Operator mapping linear colors into [0, 1].
+ *
+ */
+enum class ToneMapping
+{
+    /** Clamp the colors.*/
+    clamp,
+    /** Map each channel c to c / (1 + c), which keeps details of bright
+     *  regions.*/
+    reinhard
+};
+
+/** Parameters of post_process().
+ *
+ */
+struct PostProcessOptions
+{
+    /** Linear colors are scaled by the exposure before tone mapping.*/
+    float exposure = 1.0f;
+
+    /** Tone mapping operator.*/
+    ToneMapping tone_mapping = ToneMapping::clamp;
+
+    /** Display gamma.*/
+    float gamma = 2.2f;
+
+    /** Output value of white, e.g. 255 for 8-bit and 65535 for 16-bit
+     *  images. Integral outputs are rounded.*/
+    float max_value = 255.0f;
+
+    /** If true, the input rows are stored bottom up, like the buffers of
+     *  RayTracer, and are flipped into a top-down image.*/
+    bool flip = true;
+
+    /** If true, pixels are stored like [RGBRGBRGB...], otherwise pixels are
+     *  stored like [RRR...GGG...BBB...].*/
+    bool interleaved = true;
+};
+
+/** Convert linear colors into a displayable image.
+ *
+ *  @param pixels Output pixels, 3 channels.
+ *  @param colors Input linear colors, 3 interleaved channels.
+ *  @param width Image width.
+ *  @param height Image height.
+ *  @param options Parameters of the conversion.
+ */
+template<typename T>
+void post_process(T* pixels,
+                  const float* colors,
+                  int width,
+                  int height,
+                  const PostProcessOptions& options = PostProcessOptions());
+
+/** Convert accumulated linear colors into a displayable image.
+ *
+ *  Same as above, but the colors of each pixel are the sums of a number of
+ *  samples and are averaged first. Pixels without samples are black.
+ *
+ *  @param pixels Output pixels, 3 channels.
+ *  @param colors Input sums of linear colors, 3 interleaved channels.
+ *  @param counts Number of samples of each pixel.
+ *  @param width Image width.
+ *  @param height Image height.
+ *  @param options Parameters of the conversion.
+ */
+template<typename T>
+void post_process(T* pixels,
+                  const float* colors,
+                  const int* counts,
+                  int width,
+                  int height,
+                  const PostProcessOptions& options = PostProcessOptions());
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/PostProcess.cpp"
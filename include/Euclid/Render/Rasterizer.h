@@ -0,0 +1,123 @@
+/** Render mesh using rasterization.
+ *
+ *  For silhouettes and depth images of a single opaque mesh, rasterizing the
+ *  triangles is much cheaper than building a BVH and tracing rays, especially
+ *  for meshes only rendered a few times. This package contains a software
+ *  rasterizer which produces the same images as the ray tracer.
+ *
+ *  @defgroup PkgRasterizer Rasterizer
+ *  @ingroup PkgRender
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Euclid/Render/RayTracer.h>
+
+namespace Euclid
+{
+/** @{*/
+
+/** A software rasterizer of triangle meshes.
+ *
+ *  Images are rendered in tiles. Triangles are binned to the tiles they
+ *  overlap, then the tiles are rasterized in parallel on the render threads
+ *  shared with RayTracer. Pixels are sampled like RayTracer, so both render
+ *  the same images up to rounding on the edges of triangles.
+ *
+ *  Only PerspectiveCamera and OrthogonalCamera, and cameras derived from
+ *  them, are supported.
+ */
+class Rasterizer
+{
+public:
+    /** Create a rasterizer.
+     *
+     *  @param threads Set to 0 to use the default concurrency, see
+     *  RayTracer::set_concurrency().
+     */
+    explicit Rasterizer(int threads = 0);
+
+    /** Attach a triangle mesh to the rasterizer.
+     *
+     *  The buffers are copied, attaching a mesh again replaces the previous
+     *  one.
+     *
+     *  @param positions The mesh's positions buffer.
+     *  @param indices The mesh's indices buffer.
+     */
+    template<typename FT, typename IT>
+    void attach_geometry(const std::vector<FT>& positions,
+                         const std::vector<IT>& indices);
+
+    /** Release the attached mesh.*/
+    void release_geometry();
+
+    /** Render the mesh into a depth image.
+     *
+     *  Same as RayTracer::render_depth().
+     *
+     *  @param pixels Output pixels.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param tone_mapped If true, map depth values into range [0, 255),
+     *  otherwise the raw depth values are written. Pixels not covered by the
+     *  mesh are not modified.
+     */
+    template<typename T>
+    void render_depth(T* pixels,
+                      const Camera& camera,
+                      int width,
+                      int height,
+                      bool tone_mapped = true);
+
+    /** Render the mesh into a silhouette image.
+     *
+     *  Same as RayTracer::render_silhouette(), covered pixels are set to 255
+     *  and other pixels are not modified.
+     *
+     *  @param pixels Output pixels.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     */
+    template<typename T>
+    void render_silhouette(T* pixels,
+                           const Camera& camera,
+                           int width,
+                           int height);
+
+    /** Projected area of the mesh.
+     *
+     *  Count the pixels covered by the mesh without writing an image.
+     *
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @return The number of pixels covered by the mesh.
+     */
+    size_t projected_area(const Camera& camera, int width, int height);
+
+private:
+    // Rasterize the mesh and invoke func on each tile with its pixel range and
+    // the tile buffers, keys are only computed for depth images
+    template<typename Func>
+    void _rasterize(const Camera& camera,
+                    int width,
+                    int height,
+                    bool depth,
+                    Func&& func);
+
+private:
+    std::shared_ptr<_impl::_SharedDevice> _shared;
+    std::vector<Eigen::Vector3f> _positions;
+    std::vector<unsigned> _indices;
+};
+
+/** @}*/
+} // namespace Euclid
+
+#include "src/Rasterizer.cpp"
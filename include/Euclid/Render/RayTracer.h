@@ -9,8 +9,11 @@
 #pragma once
 
 #define _USE_MATH_DEFINES
+#include <chrono>
 #include <cmath>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -75,6 +78,28 @@ public:
         float near = 0.0f,
         float far = std::numeric_limits<float>::max()) const = 0;
 
+    /** Generate a packet of 8 embree rayhit structures.
+     *
+     *  Generate rays for pixels (s[i], t[i]) on the film plane, i = 0...7,
+     *  in the layout of Embree's ray packets. The default implementation
+     *  calls gen_ray() for each ray, derived cameras override it to generate
+     *  the whole packet at once. RayTracer generates the rays of
+     *  PerspectiveCamera and OrthogonalCamera itself without calling this
+     *  function, it is only used for other camera types.
+     *
+     *  @param s The u coordinates on the film plane, range in [0, 1).
+     *  @param t The v coordinates on the film plane, range in [0, 1).
+     *  @param rayhits The output ray packet.
+     *  @param near The value of ray parameter for the near end point.
+     *  @param far The value of ray parameter for the far end point.
+     */
+    virtual void gen_ray8(
+        const float* s,
+        const float* t,
+        RTCRayHit8& rayhits,
+        float near = 0.0f,
+        float far = std::numeric_limits<float>::max()) const;
+
 public:
     /** Camera position.*/
     Eigen::Vector3f pos{ 0.0f, 0.0f, 0.0f };
@@ -139,6 +164,17 @@ public:
         float t,
         float near = 0.0f,
         float far = std::numeric_limits<float>::max()) const override;
+
+    /** Generate a packet of 8 embree rayhit structures.
+     *
+     *  All rays of the packet share the camera position as origin.
+     */
+    void gen_ray8(
+        const float* s,
+        const float* t,
+        RTCRayHit8& rayhits,
+        float near = 0.0f,
+        float far = std::numeric_limits<float>::max()) const override;
 };
 
 /** An orthogonal camera.
@@ -184,6 +220,17 @@ public:
         float t,
         float near = 0.0f,
         float far = std::numeric_limits<float>::max()) const override;
+
+    /** Generate a packet of 8 embree rayhit structures.
+     *
+     *  All rays of the packet share the camera viewing direction.
+     */
+    void gen_ray8(
+        const float* s,
+        const float* t,
+        RTCRayHit8& rayhits,
+        float near = 0.0f,
+        float far = std::numeric_limits<float>::max()) const override;
 };
 
 /** A simple Phong material model.
@@ -195,22 +242,231 @@ struct Material
     Eigen::Array3f diffuse;
 };
 
+/** A lookup table mapping scalars to colors.
+ *
+ *  Used by RayTracer::render_attribute() to visualize per-vertex scalars,
+ *  e.g. curvatures, geodesic distances or segmentation labels. Colors are
+ *  display colors with components in [0, 1].
+ */
+class ColorMap
+{
+public:
+    /** Create a color map.
+     *
+     *  @param colors Control colors evenly spaced in [0, 1], at least 2.
+     *  @param size Number of entries of the lookup table, the control colors
+     *  are linearly interpolated.
+     */
+    explicit ColorMap(const std::vector<Eigen::Array3f>& colors,
+                      int size = 256);
+
+    /** Black to white.*/
+    static ColorMap gray();
+
+    /** Blue to red through cyan and yellow.*/
+    static ColorMap jet();
+
+    /** The perceptually uniform color map of matplotlib.*/
+    static ColorMap viridis();
+
+    /** Color of a value in [0, 1], values out of the range are clamped.*/
+    Eigen::Array3f operator()(float value) const;
+
+private:
+    std::vector<Eigen::Array3f> _lut;
+};
+
+/** Image type rendered by RayTracer::render_views().
+ *
+ */
+enum class RenderMode
+{
+    /** Shaded image, 3 interleaved channels.*/
+    shaded,
+    /** Depth image, not tone mapped.*/
+    depth,
+    /** Silhouette image.*/
+    silhouette,
+    /** Face index image.*/
+    face_id
+};
+
+/** Type of the depth values of a G-buffer.
+ *
+ */
+enum class DepthType
+{
+    /** Distance along the viewing direction, i.e. the z value in camera
+     *  space.*/
+    linear,
+    /** Distance from the ray origin to the hit point.*/
+    euclidean
+};
+
+/** Output buffers of a single-pass rendering.
+ *
+ *  Every buffer is optional, only the non-null ones are filled. All buffers
+ *  have width * height pixels stored in the same order as the other
+ *  rendering functions, with the given number of channels per pixel.
+ *  Pixels not covered by any geometry get 0, or RTC_INVALID_GEOMETRY_ID
+ *  for the index buffers.
+ */
+struct GBuffer
+{
+    /** Depth, 1 channel.*/
+    float* depth = nullptr;
+
+    /** Type of the depth values.*/
+    DepthType depth_type = DepthType::euclidean;
+
+    /** Unit geometric normal in world space, 3 channels.*/
+    float* normal = nullptr;
+
+    /** Index of the hit face within its geometry, 1 channel.*/
+    unsigned* primitive = nullptr;
+
+    /** Geometry ID of the hit geometry or instance, 1 channel.*/
+    unsigned* geometry = nullptr;
+
+    /** Barycentric coordinates (u, v) of the hit point, 2 channels.*/
+    float* barycentric = nullptr;
+
+    /** Silhouette mask, 255 for covered pixels, 1 channel.*/
+    unsigned char* mask = nullptr;
+
+    /** Shaded color as render_shaded() with one sample, 3 channels
+     *  interleaved.*/
+    unsigned char* color = nullptr;
+};
+
+/** Parameters of adaptive sampling, see RayTracer::render_shaded().
+ *
+ */
+struct AdaptiveSampling
+{
+    /** Number of samples of every pixel.*/
+    int min_samples = 4;
+
+    /** Maximum number of samples of a pixel.*/
+    int max_samples = 16;
+
+    /** Pixels are refined if the standard error of the mean luminance of
+     *  their samples exceeds this value, luminance being in [0, 1].*/
+    float threshold = 0.02f;
+
+    /** Maximum average number of samples per pixel of the image, 0 means
+     *  no limit. The first min_samples samples are always traced.*/
+    float budget = 0.0f;
+};
+
+/** A point of a virtual scan, see RayTracer::scan().
+ *
+ */
+struct ScanPoint
+{
+    /** Position in world space.*/
+    Eigen::Vector3f position;
+
+    /** Unit geometric normal in world space, facing the camera.*/
+    Eigen::Vector3f normal;
+
+    /** Index of the camera which scanned the point.*/
+    unsigned view;
+
+    /** Index of the hit face within its geometry.*/
+    unsigned primitive;
+
+    /** Geometry ID of the hit geometry or instance.*/
+    unsigned geometry;
+};
+
+/** Sampling and noise of a virtual scan, see RayTracer::scan().
+ *
+ *  The noise of a point only depends on the seed, the view and the pixel, so
+ *  scans are reproducible regardless of the number of threads.
+ */
+struct ScanOptions
+{
+    /** Only scan every stride-th pixel in both directions.*/
+    int stride = 1;
+
+    /** Standard deviation of the gaussian noise of depth along the rays, in
+     *  world units.*/
+    float depth_noise = 0.0f;
+
+    /** Standard deviation of the gaussian noise of depth relative to the
+     *  depth, added to depth_noise.*/
+    float relative_noise = 0.0f;
+
+    /** Standard deviation of the gaussian noise of normals, in radians.*/
+    float normal_noise = 0.0f;
+
+    /** Maximum angle between a ray and the surface normal in degrees,
+     *  surfaces seen at more grazing angles are not scanned.*/
+    float max_incidence = 90.0f;
+
+    /** Probability of dropping a point.*/
+    float dropout = 0.0f;
+
+    /** Seed of the noise.*/
+    unsigned seed = 0;
+};
+
+namespace _impl
+{
+struct _Packet;
+class _TileScheduler;
+struct _SharedDevice;
+} // namespace _impl
+
 /** A simple ray tracer.
  *
- *  This ray tracer could render the shaded, depth or silhouette image of a
- *  single mesh model.
+ *  This ray tracer could render the shaded, depth, silhouette or face index
+ *  image of a scene of meshes.
+ *
+ *  A scene is made of geometries and instances, both are identified by the
+ *  geometry ID returned when they are added, which stays valid until they are
+ *  released. An instance places a prototype mesh in the scene with an affine
+ *  transformation, and all instances of the same prototype share its
+ *  acceleration structure.
+ *
+ *  Images are split into tiles which are rendered in parallel by a pool of
+ *  threads with work stealing, and the pixels of a tile are traced in
+ *  coherent packets of 4x2 rays.
  */
 class RayTracer
 {
 public:
     /** Create a ray tracer.
      *
-     *  @param threads Set to 0 to use number of hardware threads.
+     *  Ray tracers using the same number of threads share one Embree device
+     *  and one pool of render threads, while each has its own scene. So
+     *  creating a ray tracer is cheap, and concurrent ray tracers do not
+     *  oversubscribe the cores.
+     *
+     *  @param threads Set to 0 to use the default concurrency, see
+     *  set_concurrency().
      */
     explicit RayTracer(int threads = 0);
 
     ~RayTracer();
 
+    RayTracer(const RayTracer&) = delete;
+
+    RayTracer& operator=(const RayTracer&) = delete;
+
+    /** Set the default number of threads of ray tracers.
+     *
+     *  It applies to ray tracers created afterwards, the default is the
+     *  number of hardware threads.
+     *
+     *  @param threads Set to 0 to use number of hardware threads.
+     */
+    static void set_concurrency(int threads);
+
+    /** The default number of threads of ray tracers.*/
+    static int concurrency();
+
     /** Attach geoemtry to the ray tracer.
      *
      *  @param positions The geometry's positions buffer.
@@ -219,8 +475,9 @@ public:
      *  RTC_GEOMETRY_TYPE_QUAD.
      *
      *  #### Note
-     *  This class can only render one mesh at a time. Attach geometry once
-     *  again will automatically release the previously attached geometry.
+     *  This function renders one mesh at a time. Attach geometry once
+     *  again will automatically release all the previously attached
+     *  geometries, use add_geometry() to build a scene of several meshes.
      */
     template<typename FT, typename IT>
     void attach_geometry(const std::vector<FT>& positions,
@@ -239,25 +496,201 @@ public:
      *  RTC_GEOMETRY_TYPE_QUAD.
      *
      *  #### Note
-     *  This class can only render one mesh at a time. Attach geometry once
-     *  again will automatically release the previously attached geometry.
+     *  This function renders one mesh at a time. Attach geometry once
+     *  again will automatically release all the previously attached
+     *  geometries, use add_geometry_shared() to build a scene of several
+     *  meshes.
      */
     void attach_geometry_shared(
         const std::vector<float>& positions,
         const std::vector<unsigned>& indices,
         RTCGeometryType type = RTC_GEOMETRY_TYPE_TRIANGLE);
 
-    /** Release geometry.*/
+    /** Add geometry to the scene.
+     *
+     *  @param positions The geometry's positions buffer.
+     *  @param indices The geometry's indices buffer.
+     *  @param type The geometry's type, be either RTC_GEOMETRY_TYPE_TRIANGLE or
+     *  RTC_GEOMETRY_TYPE_QUAD.
+     *  @return The geometry ID.
+     */
+    template<typename FT, typename IT>
+    unsigned add_geometry(const std::vector<FT>& positions,
+                          const std::vector<IT>& indices,
+                          RTCGeometryType type = RTC_GEOMETRY_TYPE_TRIANGLE);
+
+    /** Add geometry to the scene using shared buffers.
+     *
+     *  The positions buffer must be padded like attach_geometry_shared().
+     *
+     *  @param positions The geometry's positions buffer.
+     *  @param indices The geometry's indices buffer.
+     *  @param type The geometry's type, be either RTC_GEOMETRY_TYPE_TRIANGLE or
+     *  RTC_GEOMETRY_TYPE_QUAD.
+     *  @return The geometry ID.
+     */
+    unsigned add_geometry_shared(
+        const std::vector<float>& positions,
+        const std::vector<unsigned>& indices,
+        RTCGeometryType type = RTC_GEOMETRY_TYPE_TRIANGLE);
+
+    /** Add a prototype mesh for instancing.
+     *
+     *  The acceleration structure of a prototype is built once here. A
+     *  prototype is not visible by itself, use add_instance() to place it in
+     *  the scene.
+     *
+     *  @param positions The prototype's positions buffer.
+     *  @param indices The prototype's indices buffer.
+     *  @param type The prototype's type, be either RTC_GEOMETRY_TYPE_TRIANGLE
+     *  or RTC_GEOMETRY_TYPE_QUAD.
+     *  @return The prototype ID.
+     */
+    template<typename FT, typename IT>
+    unsigned add_prototype(const std::vector<FT>& positions,
+                           const std::vector<IT>& indices,
+                           RTCGeometryType type = RTC_GEOMETRY_TYPE_TRIANGLE);
+
+    /** Add an instance of a prototype to the scene.
+     *
+     *  @param prototype The prototype ID.
+     *  @param transform Transformation from the prototype's object space to
+     *  world space.
+     *  @return The geometry ID of the instance.
+     */
+    unsigned add_instance(
+        unsigned prototype,
+        const Eigen::Affine3f& transform = Eigen::Affine3f::Identity());
+
+    /** Add a mesh to the scene through the process-wide scene cache.
+     *
+     *  Meshes are identified by a 64-bit hash of their buffers and their
+     *  sizes. If a mesh of the same content has been added before, with the
+     *  same scene flags and build quality, its committed acceleration
+     *  structure is reused and placed as an instance without building
+     *  anything. Otherwise the mesh is built as a prototype and cached.
+     *  Cached prototypes are shared between ray tracers and are not
+     *  affected by set_scene_flags().
+     *
+     *  @param positions The mesh's positions buffer.
+     *  @param indices The mesh's indices buffer.
+     *  @param type The mesh's type, be either RTC_GEOMETRY_TYPE_TRIANGLE or
+     *  RTC_GEOMETRY_TYPE_QUAD.
+     *  @param transform Transformation from the mesh's object space to world
+     *  space.
+     *  @return The geometry ID of the instance.
+     */
+    template<typename FT, typename IT>
+    unsigned add_cached(
+        const std::vector<FT>& positions,
+        const std::vector<IT>& indices,
+        RTCGeometryType type = RTC_GEOMETRY_TYPE_TRIANGLE,
+        const Eigen::Affine3f& transform = Eigen::Affine3f::Identity());
+
+    /** Set the memory budget of the scene cache in bytes.
+     *
+     *  The least recently used scenes are evicted when their estimated
+     *  memory exceeds the budget, the default is 1GB. Scenes still used by
+     *  ray tracers are only freed when they are released.
+     */
+    static void set_cache_budget(size_t bytes);
+
+    /** Remove all scenes from the scene cache.*/
+    static void clear_cache();
+
+    /** Change the transformation of an instance.
+     *
+     *  Throws std::invalid_argument if id is not an instance.
+     */
+    void set_transform(unsigned id, const Eigen::Affine3f& transform);
+
+    /** Update the vertex positions of a geometry.
+     *
+     *  The positions are copied into the geometry's own buffer and its
+     *  acceleration structure is refitted instead of rebuilt, which is much
+     *  faster for deforming meshes as long as the connectivity is kept.
+     *
+     *  @param id The geometry ID, returned by add_geometry().
+     *  @param positions The new positions buffer, of the same size as the
+     *  original one.
+     */
+    template<typename FT>
+    void update_positions(unsigned id, const std::vector<FT>& positions);
+
+    /** Refit a geometry after its shared positions buffer is modified.
+     *
+     *  @param id The geometry ID, returned by add_geometry_shared().
+     */
+    void update_positions(unsigned id);
+
+    /** Set a per-vertex attribute of a geometry, see render_attribute().
+     *
+     *  The values are copied, setting the attribute again replaces the
+     *  previous one.
+     *
+     *  @param id The geometry ID, returned by add_geometry(),
+     *  add_geometry_shared() or 0 for attach_geometry().
+     *  @param values The attribute values, channels values per vertex.
+     *  @param channels Either 1 for scalars or 3 for colors.
+     */
+    template<typename FT>
+    void set_vertex_attribute(unsigned id,
+                              const std::vector<FT>& values,
+                              int channels = 1);
+
+    /** Release a geometry or an instance.*/
+    void release_geometry(unsigned id);
+
+    /** Release all geometries, instances and prototypes.*/
     void release_geometry();
 
-    /** Change the material of the model.*/
+    /** Change the material of all geometries.
+     *
+     *  It also becomes the material of geometries added afterwards.
+     */
     void set_material(const Material& material);
 
-    /** Render the mesh into a shaded image.
+    /** Change the material of a geometry or an instance.*/
+    void set_material(unsigned id, const Material& material);
+
+    /** Set the flags of the scene and the prototypes.
+     *
+     *  Prototypes of add_cached() keep the flags they were built with.
+     *  E.g. RTC_SCENE_FLAG_DYNAMIC for scenes updated every frame,
+     *  RTC_SCENE_FLAG_COMPACT to save memory and RTC_SCENE_FLAG_ROBUST to
+     *  avoid optimizations reducing the arithmetic accuracy.
+     */
+    void set_scene_flags(RTCSceneFlags flags);
+
+    /** Set the build quality of acceleration structures.
+     *
+     *  It applies to the scene and the geometries and prototypes added
+     *  afterwards. Use RTC_BUILD_QUALITY_LOW for fast builds of frequently
+     *  changing scenes and RTC_BUILD_QUALITY_HIGH for faster tracing of
+     *  static ones, the default is RTC_BUILD_QUALITY_MEDIUM.
+     */
+    void set_build_quality(RTCBuildQuality quality);
+
+    /** Commit changes of the scene.
+     *
+     *  Rendering commits pending changes automatically. Commit explicitly
+     *  before rendering from several threads at the same time.
+     */
+    void commit();
+
+    /** Get the Embree scene.
+     *
+     *  Pending changes are committed first. The scene could be used to trace
+     *  custom rays with Embree's API, and stays valid until all geometries
+     *  are released.
+     */
+    RTCScene scene();
+
+    /** Render the scene into a shaded image.
      *
-     *  This function renders the mesh with simple lambertian shading and store
-     *  the pixel values to an array, using a point light located at the camera
-     *  position.
+     *  This function renders the scene with simple lambertian shading and
+     *  store the pixel values to an array, using a point light located at the
+     *  camera position.
      *
      *  @param pixels Output pixels
      *  @param camera Camera.
@@ -266,6 +699,12 @@ public:
      *  @param samples Number of samples per pixel.
      *  @param interleaved If true, pixels are stored like [RGBRGBRGB...],
      *  otherwise pixels are stored like [RRR...GGG...BBB...].
+     *  @param seed Seed of the sample patterns.
+     *
+     *  #### Note
+     *  The samples of a pixel are stratified and only depend on the seed and
+     *  the pixel location, so the same seed always reproduces the same image
+     *  regardless of the number of threads.
      */
     template<typename T>
     void render_shaded(T* pixels,
@@ -273,9 +712,93 @@ public:
                        int width,
                        int height,
                        int samples = 1,
-                       bool interleaved = true);
+                       bool interleaved = true,
+                       unsigned seed = 0);
+
+    /** Render the scene into linear colors.
+     *
+     *  Same as render_shaded() but the averaged colors are written before
+     *  gamma correction and quantization, so they could be post-processed
+     *  with other parameters, see post_process().
+     *
+     *  @param colors Output linear colors, 3 interleaved channels, the rows
+     *  are stored bottom up.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param samples Number of samples per pixel.
+     *  @param seed Seed of the sample patterns.
+     */
+    void render_linear(float* colors,
+                       const Camera& camera,
+                       int width,
+                       int height,
+                       int samples = 1,
+                       unsigned seed = 0);
 
-    /** Render the mesh into a depth image.
+    /** Render the scene into a shaded image with adaptive sampling.
+     *
+     *  Every pixel is first traced with sampling.min_samples samples, then
+     *  the pixels whose samples see different geometries, or whose colors
+     *  vary too much, are refined up to sampling.max_samples samples, so
+     *  flat regions stay cheap while edges are anti-aliased. If the refined
+     *  pixels would exceed the budget, their extra samples are reduced
+     *  evenly.
+     *
+     *  @param pixels Output pixels
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param sampling Parameters of adaptive sampling.
+     *  @param interleaved If true, pixels are stored like [RGBRGBRGB...],
+     *  otherwise pixels are stored like [RRR...GGG...BBB...].
+     *  @param seed Seed of the sample patterns.
+     *  @return The average number of samples per pixel.
+     */
+    template<typename T>
+    float render_shaded(T* pixels,
+                        const Camera& camera,
+                        int width,
+                        int height,
+                        const AdaptiveSampling& sampling,
+                        bool interleaved = true,
+                        unsigned seed = 0);
+
+    /** Render the scene progressively into a shaded image.
+     *
+     *  Samples are added in passes of 1, 1, 2, 4... samples per pixel and
+     *  the image is updated after each pass, until max_samples or the time
+     *  budget is reached. The first pass is always completed, later passes
+     *  stop at the deadline and leave the remaining pixels with fewer
+     *  samples, so the function returns shortly after the deadline with the
+     *  best image available.
+     *
+     *  @param pixels Output pixels
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param max_samples Maximum number of samples per pixel.
+     *  @param budget Time budget.
+     *  @param interleaved If true, pixels are stored like [RGBRGBRGB...],
+     *  otherwise pixels are stored like [RRR...GGG...BBB...].
+     *  @param seed Seed of the sample patterns.
+     *  @param callback If not empty, it is invoked after each pass with the
+     *  number of samples per pixel traced so far, e.g. to display the image.
+     *  @return The number of samples of the least sampled pixel.
+     */
+    template<typename T>
+    int render_progressive(
+        T* pixels,
+        const Camera& camera,
+        int width,
+        int height,
+        int max_samples,
+        std::chrono::milliseconds budget,
+        bool interleaved = true,
+        unsigned seed = 0,
+        const std::function<void(int)>& callback = nullptr);
+
+    /** Render the scene into a depth image.
      *
      *  @param pixels Output pixels.
      *  @param camera Camera.
@@ -291,7 +814,7 @@ public:
                       int height,
                       bool tone_mapped = true);
 
-    /** Render the mesh into a silhouette image.
+    /** Render the scene into a silhouette image.
      *
      *  @param pixels Output pixels.
      *  @param camera Camera.
@@ -304,12 +827,217 @@ public:
                            int width,
                            int height);
 
+    /** Render the scene into a face index image.
+     *
+     *  Each pixel stores the index of the face visible through it within its
+     *  geometry, pixels not covered by any geometry are set to
+     *  RTC_INVALID_GEOMETRY_ID.
+     *
+     *  @param pixels Output pixels.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     */
+    void render_face_id(unsigned* pixels,
+                        const Camera& camera,
+                        int width,
+                        int height);
+
+    /** Render the scene colored by the per-vertex attributes.
+     *
+     *  The attribute of each hit is interpolated from the vertices of the hit
+     *  face, once per geometry of a ray packet. Scalars are normalized into
+     *  [0, 1] by the range [min, max] and mapped to colors by the color map,
+     *  while 3-channel attributes are used as colors directly. Geometries
+     *  without attributes and instances are drawn in their material colors.
+     *
+     *  @param pixels Output pixels, 3 channels.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param colormap Color map of scalar attributes.
+     *  @param min Value mapped to the first color of the color map.
+     *  @param max Value mapped to the last color of the color map.
+     *  @param shaded If true, colors are modulated by the lambertian shading
+     *  of render_shaded(), otherwise they are written as is.
+     *  @param interleaved If true, pixels are stored like [RGBRGBRGB...],
+     *  otherwise pixels are stored like [RRR...GGG...BBB...].
+     */
+    template<typename T>
+    void render_attribute(T* pixels,
+                          const Camera& camera,
+                          int width,
+                          int height,
+                          const ColorMap& colormap = ColorMap::viridis(),
+                          float min = 0.0f,
+                          float max = 1.0f,
+                          bool shaded = true,
+                          bool interleaved = true);
+
+    /** Render the scene from a batch of cameras.
+     *
+     *  The tiles of all views are rendered in parallel as a whole, which
+     *  balances the work much better than rendering many small images one by
+     *  one.
+     *
+     *  @param pixels Output pixels of all views, the images are stored one
+     *  after another, each with the channels of the render mode. Depth
+     *  images require a floating point type and face index images an
+     *  integral type of at least 32 bits, e.g. unsigned, otherwise
+     *  std::invalid_argument is thrown.
+     *  @param cameras The cameras, one per view.
+     *  @param width Image width.
+     *  @param height Image height.
+     *  @param mode The type of image to render.
+     *  @param samples Number of samples per pixel for shaded images.
+     */
+    template<typename CameraT, typename T>
+    void render_views(T* pixels,
+                      const std::vector<CameraT>& cameras,
+                      int width,
+                      int height,
+                      RenderMode mode = RenderMode::shaded,
+                      int samples = 1);
+
+    /** Render several images of the scene in a single pass.
+     *
+     *  Each primary ray is traced once, and all the requested buffers are
+     *  filled from the same hit.
+     *
+     *  @param gbuffer The output buffers.
+     *  @param camera Camera.
+     *  @param width Image width.
+     *  @param height Image height.
+     */
+    void render_gbuffer(const GBuffer& gbuffer,
+                        const Camera& camera,
+                        int width,
+                        int height);
+
+    /** Scan the scene from several views into a point cloud.
+     *
+     *  Like a depth sensor, the primary rays of each view are traced and the
+     *  hits are back-projected into points with their normals and the faces
+     *  they lie on. The tiles of all views are traced in parallel, and the
+     *  points of all views are merged into one buffer, ordered by view and
+     *  then by tile.
+     *
+     *  @param cameras The cameras, one per view.
+     *  @param width Image width of the views.
+     *  @param height Image height of the views.
+     *  @param points The output points.
+     *  @param options Subsampling and noise of the scan.
+     */
+    template<typename CameraT>
+    void scan(const std::vector<CameraT>& cameras,
+              int width,
+              int height,
+              std::vector<ScanPoint>& points,
+              const ScanOptions& options = ScanOptions());
+
 private:
+    template<typename FT, typename IT>
+    RTCGeometry _new_geometry(const std::vector<FT>& positions,
+                              const std::vector<IT>& indices,
+                              RTCGeometryType type);
+
+    RTCGeometry _new_geometry_shared(const std::vector<float>& positions,
+                                     const std::vector<unsigned>& indices,
+                                     RTCGeometryType type);
+
+    RTCScene _new_scene();
+
+    // Throw if id is not an attached geometry or instance
+    void _check_id(unsigned id) const;
+
+    unsigned _attach(RTCGeometry geometry,
+                     const Eigen::Matrix3f& normal_matrix =
+                         Eigen::Matrix3f::Identity());
+
+    // Geometry ID of the hit in the top level scene
+    static unsigned _hit_id(const RTCRayHit8& rayhits, int i);
+
+    // Trace a packet of primary rays and write the pixels of an image type,
+    // rays are generated by one of the ray generators of the cameras. Shaded
+    // packets output the linear colors of their lanes instead.
+    template<typename Rays>
+    void _trace_shaded(const _impl::_Packet& packet,
+                       Eigen::Array3f* colors,
+                       const Rays& rays,
+                       int width,
+                       int samples,
+                       unsigned seed) const;
+
+    template<typename Rays, typename T>
+    void _trace_depth(const _impl::_Packet& packet,
+                      T* pixels,
+                      const Rays& rays,
+                      int width,
+                      int height,
+                      bool tone_mapped) const;
+
+    template<typename Rays, typename T>
+    void _trace_silhouette(const _impl::_Packet& packet,
+                           T* pixels,
+                           const Rays& rays,
+                           int width,
+                           int height) const;
+
+    template<typename Rays, typename T>
+    void _trace_face_id(const _impl::_Packet& packet,
+                        T* pixels,
+                        const Rays& rays,
+                        int width,
+                        int height) const;
+
+    template<typename Rays, typename T>
+    void _trace_attribute(const _impl::_Packet& packet,
+                          T* pixels,
+                          const Rays& rays,
+                          int width,
+                          int height,
+                          const ColorMap& colormap,
+                          float min,
+                          float max,
+                          bool shaded,
+                          bool interleaved) const;
+
+    // Unit geometric normal of the hit in world space
+    Eigen::Vector3f _hit_normal(const RTCRayHit8& rayhits, int i) const;
+
+    // Lambertian shading of the hit, lit from the ray origin
+    Eigen::Array3f _shade(const RTCRayHit8& rayhits, int i) const;
+
+private:
+    // Properties of a geometry in the top level scene
+    struct Object
+    {
+        Material material;
+        // Transforms hit normals in object space into world space
+        Eigen::Matrix3f normal_matrix;
+        // Number of vertices of a mesh, 0 for instances
+        size_t vertices = 0;
+        bool shared = false;
+        // Number of channels of the vertex attribute, 0 if not set
+        int attribute_channels = 0;
+        bool instance = false;
+        // False for IDs which are free or released
+        bool attached = false;
+    };
+
+    std::shared_ptr<_impl::_SharedDevice> _shared;
+    // Shortcuts of the shared device
     RTCDevice _device;
+    _impl::_TileScheduler* _scheduler;
     RTCScene _scene;
-    RTCGeometry _geometry;
-    int _geom_id = -1;
+    std::vector<RTCScene> _prototypes;
+    // Whether each prototype is shared through the scene cache
+    std::vector<bool> _cached;
+    std::vector<Object> _objects;
     Material _material;
+    RTCSceneFlags _scene_flags = RTC_SCENE_FLAG_NONE;
+    RTCBuildQuality _build_quality = RTC_BUILD_QUALITY_MEDIUM;
+    bool _dirty = false;
 };
 
 /** @}*/
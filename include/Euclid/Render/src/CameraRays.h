@@ -0,0 +1,271 @@
+#pragma once
+
+#include <limits>
+#include <typeinfo>
+#include <variant>
+
+#include <embree3/rtcore.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Images are rendered tile by tile, and each tile packet by packet
+constexpr int _tile_size = 16;
+constexpr int _packet_width = 4;
+constexpr int _packet_height = 2;
+constexpr int _packet_size = _packet_width * _packet_height;
+
+// Pixel coordinates of a packet of rays, pixels outside of the image are
+// masked out by valid
+struct _Packet
+{
+    alignas(32) int valid[_packet_size];
+    int x[_packet_size];
+    int y[_packet_size];
+};
+
+inline void _init_rayhit8(RTCRayHit8& rayhits, int i, float near, float far)
+{
+    rayhits.ray.tnear[i] = near;
+    rayhits.ray.tfar[i] = far;
+    rayhits.ray.time[i] = 0.0f;
+    rayhits.ray.mask[i] = 0xFFFFFFFF;
+    rayhits.ray.id[i] = i;
+    rayhits.ray.flags[i] = 0;
+    rayhits.hit.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+    rayhits.hit.instID[0][i] = RTC_INVALID_GEOMETRY_ID;
+}
+
+// Ray generators of the cameras, resolved once per render so the kernels
+// generate packets without virtual calls.
+// Rays are generated for pixel coordinates in [0, width) x [0, height), pixel
+// (x, y) being at (x / width, y / height) on the film plane. The film plane is
+// stored as its corner and the steps of one pixel, so the rays of a packet
+// are generated by stepping from its first pixel.
+struct _FilmSteps
+{
+    _FilmSteps(const Eigen::Vector3f& center,
+               const Camera& camera,
+               int width,
+               int height)
+    {
+        Eigen::Vector3f u = camera.film.width * camera.u;
+        Eigen::Vector3f v = camera.film.height * camera.v;
+        Eigen::Vector3f c = center - 0.5f * u - 0.5f * v;
+        u /= static_cast<float>(width);
+        v /= static_cast<float>(height);
+        for (int i = 0; i < 3; ++i) {
+            corner[i] = c(i);
+            du[i] = u(i);
+            dv[i] = v(i);
+        }
+    }
+
+    // Point of the film plane at the pixel coordinates (x, y)
+    void point(float x, float y, float* p) const
+    {
+        p[0] = corner[0] + x * du[0] + y * dv[0];
+        p[1] = corner[1] + x * du[1] + y * dv[1];
+        p[2] = corner[2] + x * du[2] + y * dv[2];
+    }
+
+    float corner[3];
+    float du[3];
+    float dv[3];
+};
+
+// Rays of a PerspectiveCamera start from the camera position, towards the
+// film plane at unit distance
+class _PerspectiveRays
+{
+public:
+    _PerspectiveRays(const PerspectiveCamera& camera, int width, int height)
+        : _steps(-camera.dir, camera, width, height),
+          _org{ camera.pos(0), camera.pos(1), camera.pos(2) }
+    {}
+
+    // Rays through the pixels (x[i], y[i]), i = 0...7
+    void operator()(const float* x,
+                    const float* y,
+                    RTCRayHit8& rayhits,
+                    float near = 0.0f,
+                    float far = std::numeric_limits<float>::max()) const
+    {
+        for (int i = 0; i < 8; ++i) {
+            float p[3];
+            _steps.point(x[i], y[i], p);
+            _set(rayhits, i, p);
+            _init_rayhit8(rayhits, i, near, far);
+        }
+    }
+
+    // Rays through the pixels of a packet
+    void operator()(const _Packet& packet, RTCRayHit8& rayhits) const
+    {
+        for (int r = 0; r < _packet_height; ++r) {
+            float p[3];
+            _steps.point(static_cast<float>(packet.x[0]),
+                         static_cast<float>(packet.y[0] + r),
+                         p);
+            for (int c = 0; c < _packet_width; ++c) {
+                const int i = r * _packet_width + c;
+                _set(rayhits, i, p);
+                _init_rayhit8(
+                    rayhits, i, 0.0f, std::numeric_limits<float>::max());
+                p[0] += _steps.du[0];
+                p[1] += _steps.du[1];
+                p[2] += _steps.du[2];
+            }
+        }
+    }
+
+private:
+    void _set(RTCRayHit8& rayhits, int i, const float* p) const
+    {
+        rayhits.ray.org_x[i] = _org[0];
+        rayhits.ray.org_y[i] = _org[1];
+        rayhits.ray.org_z[i] = _org[2];
+        rayhits.ray.dir_x[i] = p[0];
+        rayhits.ray.dir_y[i] = p[1];
+        rayhits.ray.dir_z[i] = p[2];
+    }
+
+private:
+    _FilmSteps _steps;
+    float _org[3];
+};
+
+// Rays of an OrthogonalCamera start from the film plane through the camera
+// position, along the viewing direction
+class _OrthogonalRays
+{
+public:
+    _OrthogonalRays(const OrthogonalCamera& camera, int width, int height)
+        : _steps(camera.pos, camera, width, height),
+          _dir{ -camera.dir(0), -camera.dir(1), -camera.dir(2) }
+    {}
+
+    // Rays through the pixels (x[i], y[i]), i = 0...7
+    void operator()(const float* x,
+                    const float* y,
+                    RTCRayHit8& rayhits,
+                    float near = 0.0f,
+                    float far = std::numeric_limits<float>::max()) const
+    {
+        for (int i = 0; i < 8; ++i) {
+            float p[3];
+            _steps.point(x[i], y[i], p);
+            _set(rayhits, i, p);
+            _init_rayhit8(rayhits, i, near, far);
+        }
+    }
+
+    // Rays through the pixels of a packet
+    void operator()(const _Packet& packet, RTCRayHit8& rayhits) const
+    {
+        for (int r = 0; r < _packet_height; ++r) {
+            float p[3];
+            _steps.point(static_cast<float>(packet.x[0]),
+                         static_cast<float>(packet.y[0] + r),
+                         p);
+            for (int c = 0; c < _packet_width; ++c) {
+                const int i = r * _packet_width + c;
+                _set(rayhits, i, p);
+                _init_rayhit8(
+                    rayhits, i, 0.0f, std::numeric_limits<float>::max());
+                p[0] += _steps.du[0];
+                p[1] += _steps.du[1];
+                p[2] += _steps.du[2];
+            }
+        }
+    }
+
+private:
+    void _set(RTCRayHit8& rayhits, int i, const float* p) const
+    {
+        rayhits.ray.org_x[i] = p[0];
+        rayhits.ray.org_y[i] = p[1];
+        rayhits.ray.org_z[i] = p[2];
+        rayhits.ray.dir_x[i] = _dir[0];
+        rayhits.ray.dir_y[i] = _dir[1];
+        rayhits.ray.dir_z[i] = _dir[2];
+    }
+
+private:
+    _FilmSteps _steps;
+    float _dir[3];
+};
+
+// Other cameras generate rays through Camera::gen_ray8()
+class _GenericRays
+{
+public:
+    _GenericRays(const Camera& camera, int width, int height)
+        : _camera(&camera),
+          _rcp_width(1.0f / width),
+          _rcp_height(1.0f / height)
+    {}
+
+    void operator()(const float* x,
+                    const float* y,
+                    RTCRayHit8& rayhits,
+                    float near = 0.0f,
+                    float far = std::numeric_limits<float>::max()) const
+    {
+        float s[8];
+        float t[8];
+        for (int i = 0; i < 8; ++i) {
+            s[i] = x[i] * _rcp_width;
+            t[i] = y[i] * _rcp_height;
+        }
+        _camera->gen_ray8(s, t, rayhits, near, far);
+    }
+
+    void operator()(const _Packet& packet, RTCRayHit8& rayhits) const
+    {
+        float x[_packet_size];
+        float y[_packet_size];
+        for (int i = 0; i < _packet_size; ++i) {
+            x[i] = static_cast<float>(packet.x[i]);
+            y[i] = static_cast<float>(packet.y[i]);
+        }
+        (*this)(x, y, rayhits);
+    }
+
+private:
+    const Camera* _camera;
+    float _rcp_width;
+    float _rcp_height;
+};
+
+using _CameraRays =
+    std::variant<_PerspectiveRays, _OrthogonalRays, _GenericRays>;
+
+// Only the exact camera types are specialized, derived cameras may override
+// the ray generation
+inline _CameraRays _camera_rays(const Camera& camera, int width, int height)
+{
+    if (typeid(camera) == typeid(PerspectiveCamera)) {
+        return _PerspectiveRays(
+            static_cast<const PerspectiveCamera&>(camera), width, height);
+    }
+    if (typeid(camera) == typeid(OrthogonalCamera)) {
+        return _OrthogonalRays(
+            static_cast<const OrthogonalCamera&>(camera), width, height);
+    }
+    return _GenericRays(camera, width, height);
+}
+
+// Invoke func with the ray generator of the camera
+template<typename Func>
+void _visit_camera(const Camera& camera, int width, int height, Func&& func)
+{
+    std::visit(std::forward<Func>(func), _camera_rays(camera, width, height));
+}
+
+} // namespace _impl
+
+} // namespace Euclid
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <embree3/rtcore.h>
+
+#include "TileScheduler.h"
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// An Embree device and the render threads, shared by ray tracers using the
+// same number of threads
+struct _SharedDevice
+{
+    explicit _SharedDevice(int threads) : scheduler(threads)
+    {
+        std::string cfg("threads=");
+        cfg.append(std::to_string(threads));
+        device = rtcNewDevice(cfg.c_str());
+        if (!device) {
+            auto err = rtcGetDeviceError(device);
+            std::string err_str("Embree device creation error: ");
+            err_str.append(std::to_string(err));
+            throw std::runtime_error(err_str);
+        }
+    }
+
+    ~_SharedDevice() { rtcReleaseDevice(device); }
+
+    _SharedDevice(const _SharedDevice&) = delete;
+
+    _SharedDevice& operator=(const _SharedDevice&) = delete;
+
+    RTCDevice device;
+    _TileScheduler scheduler;
+};
+
+// Process-wide registry of shared devices.
+// A device lives as long as a ray tracer uses it, except the device of the
+// default concurrency which is kept once created, so short-lived ray tracers
+// do not pay for creating devices and threads.
+class _DeviceRegistry
+{
+public:
+    static _DeviceRegistry& instance()
+    {
+        static _DeviceRegistry registry;
+        return registry;
+    }
+
+    // Set threads to 0 to use the default concurrency
+    std::shared_ptr<_SharedDevice> acquire(int threads)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (threads <= 0) { threads = _concurrency; }
+
+        auto device = _devices[threads].lock();
+        if (!device) {
+            device = std::make_shared<_SharedDevice>(threads);
+            _devices[threads] = device;
+        }
+        if (threads == _concurrency) { _default = device; }
+        return device;
+    }
+
+    // Set threads to 0 to use number of hardware threads
+    void set_concurrency(int threads)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (threads <= 0) { threads = _hardware_threads(); }
+        if (threads != _concurrency) {
+            _concurrency = threads;
+            _default.reset();
+        }
+    }
+
+    int concurrency()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _concurrency;
+    }
+
+private:
+    _DeviceRegistry() : _concurrency(_hardware_threads()) {}
+
+    static int _hardware_threads()
+    {
+        return static_cast<int>(
+            std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+private:
+    std::mutex _mutex;
+    std::map<int, std::weak_ptr<_SharedDevice>> _devices;
+    std::shared_ptr<_SharedDevice> _default;
+    int _concurrency;
+};
+
+} // namespace _impl
+
+} // namespace Euclid
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// The gamma curve x^(1 / gamma) on [0, 1], sampled at the floats with the
+// lowest mantissa bits cleared, so the samples are dense where the curve is
+// steep. With linear interpolation it is accurate to a small fraction of an
+// 8-bit level, while being much cheaper than std::pow.
+class _GammaTable
+{
+public:
+    _GammaTable(float gamma, float scale)
+    {
+        _min = std::ldexp(1.0f, -_octaves);
+        std::memcpy(&_min_bits, &_min, sizeof(float));
+        const int n = (_octaves << _mantissa_bits) + 1;
+        _table.resize(n + 1);
+        for (int i = 0; i < n; ++i) {
+            const uint32_t bits =
+                _min_bits + (static_cast<uint32_t>(i) << _shift);
+            float x;
+            std::memcpy(&x, &bits, sizeof(float));
+            _table[i] = std::pow(x, 1.0f / gamma) * scale;
+        }
+        // The interpolation of 1.0 reads one past the last sample
+        _table[n] = _table[n - 1];
+        _slope = _table[0] / _min;
+    }
+
+    // Value of x clamped into [0, 1], NaN is mapped to 0. The index comes
+    // from the bits of x, so NaN and infinity must never reach the lookup.
+    float operator()(float x) const
+    {
+        x = x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+        if (x < _min) { return x * _slope; }
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(float));
+        const uint32_t offset = bits - _min_bits;
+        const uint32_t i = offset >> _shift;
+        const float t = static_cast<float>(offset & ((1u << _shift) - 1)) *
+                        (1.0f / (1u << _shift));
+        return _table[i] + t * (_table[i + 1] - _table[i]);
+    }
+
+private:
+    static constexpr int _octaves = 24;
+    static constexpr int _mantissa_bits = 7;
+    static constexpr int _shift = 23 - _mantissa_bits;
+
+    std::vector<float> _table;
+    float _min;
+    uint32_t _min_bits;
+    // Below the table the curve is approximated by a line
+    float _slope;
+};
+
+// The table of the default display, gamma 2.2 in [0, 255]
+inline const _GammaTable& _display_table()
+{
+    static const _GammaTable table(2.2f, 255.0f);
+    return table;
+}
+
+template<typename T>
+T _quantize(float value)
+{
+    if constexpr (std::is_integral_v<T>) {
+        return static_cast<T>(static_cast<long>(value + 0.5f));
+    }
+    else {
+        return static_cast<T>(value);
+    }
+}
+
+inline void _check_post_process(int width,
+                                int height,
+                                const PostProcessOptions& options)
+{
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Image size must be positive.");
+    }
+    if (!(options.gamma > 0.0f)) {
+        throw std::invalid_argument("Gamma must be positive.");
+    }
+}
+
+// Post-process rows [first, last) of an image, counts could be null
+template<typename T>
+void _post_process_rows(T* pixels,
+                        const float* colors,
+                        const int* counts,
+                        int width,
+                        int height,
+                        int first,
+                        int last,
+                        const _GammaTable& table,
+                        const PostProcessOptions& options)
+{
+    const int n = 3 * width;
+    std::vector<float> row(n);
+    for (int y = first; y < last; ++y) {
+        // Each pass is a simple loop over the row, which compilers vectorize
+        const float* src = colors + static_cast<size_t>(y) * n;
+        if (counts == nullptr) {
+            for (int i = 0; i < n; ++i) {
+                row[i] = src[i] * options.exposure;
+            }
+        }
+        else {
+            const int* count = counts + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; ++x) {
+                const float scale =
+                    count[x] > 0 ? options.exposure / count[x] : 0.0f;
+                row[3 * x + 0] = src[3 * x + 0] * scale;
+                row[3 * x + 1] = src[3 * x + 1] * scale;
+                row[3 * x + 2] = src[3 * x + 2] * scale;
+            }
+        }
+
+        if (options.tone_mapping == ToneMapping::reinhard) {
+            // Infinity is capped so that it maps to white instead of NaN
+            const float max_value = std::numeric_limits<float>::max();
+            for (int i = 0; i < n; ++i) {
+                const float value = std::min(std::max(row[i], 0.0f), max_value);
+                row[i] = value / (1.0f + value);
+            }
+        }
+        else {
+            for (int i = 0; i < n; ++i) {
+                row[i] = std::min(std::max(row[i], 0.0f), 1.0f);
+            }
+        }
+
+        for (int i = 0; i < n; ++i) {
+            row[i] = table(row[i]);
+        }
+
+        const size_t dst_y = options.flip ? height - y - 1 : y;
+        if (options.interleaved) {
+            T* dst = pixels + dst_y * n;
+            for (int i = 0; i < n; ++i) {
+                dst[i] = _quantize<T>(row[i]);
+            }
+        }
+        else {
+            const size_t plane = static_cast<size_t>(width) * height;
+            for (int c = 0; c < 3; ++c) {
+                T* dst = pixels + c * plane + dst_y * width;
+                for (int x = 0; x < width; ++x) {
+                    dst[x] = _quantize<T>(row[3 * x + c]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace _impl
+
+template<typename T>
+void post_process(T* pixels,
+                  const float* colors,
+                  int width,
+                  int height,
+                  const PostProcessOptions& options)
+{
+    post_process(pixels, colors, nullptr, width, height, options);
+}
+
+template<typename T>
+void post_process(T* pixels,
+                  const float* colors,
+                  const int* counts,
+                  int width,
+                  int height,
+                  const PostProcessOptions& options)
+{
+    _impl::_check_post_process(width, height, options);
+    const _impl::_GammaTable table(options.gamma, options.max_value);
+    _impl::_post_process_rows(
+        pixels, colors, counts, width, height, 0, height, table, options);
+}
+
+} // namespace Euclid
@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Images are rasterized in tiles, each row of a tile 8 pixels at a time. Rows
+// of the tile buffers are padded so a group of pixels never overflows them
+constexpr int _raster_tile_size = 32;
+constexpr int _raster_lanes = 8;
+constexpr int _raster_stride = _raster_tile_size + _raster_lanes;
+
+// Maps points into the pixel coordinates of a camera, pixel (x, y) samples the
+// film plane at (x / width, y / height) like the primary rays of RayTracer.
+// Depth is interpolated as a key which is linear in pixel coordinates and
+// larger for closer points, i.e. 1 / z for perspective cameras and -z for
+// orthogonal cameras, z being the distance along the viewing direction.
+class _Projection
+{
+public:
+    _Projection(const Camera& camera, int width, int height, float near)
+    {
+        if (dynamic_cast<const PerspectiveCamera*>(&camera) != nullptr) {
+            _perspective = true;
+            _near = near;
+        }
+        else if (dynamic_cast<const OrthogonalCamera*>(&camera) != nullptr) {
+            _perspective = false;
+            _near = 0.0f;
+        }
+        else {
+            throw std::invalid_argument(
+                "Rasterizer only supports perspective and orthogonal cameras.");
+        }
+        _pos = camera.pos;
+        _u = camera.u;
+        _v = camera.v;
+        _forward = -camera.dir;
+        _sx = width / camera.film.width;
+        _sy = height / camera.film.height;
+        _cx = 0.5f * width;
+        _cy = 0.5f * height;
+    }
+
+    // Only points in front of the near plane are visible
+    float near() const { return _near; }
+
+    Eigen::Vector3f to_camera(const Eigen::Vector3f& p) const
+    {
+        Eigen::Vector3f d = p - _pos;
+        return Eigen::Vector3f(d.dot(_u), d.dot(_v), d.dot(_forward));
+    }
+
+    // Pixel coordinates and depth key of a point in camera space
+    void project(const Eigen::Vector3f& q, float& x, float& y, float& key) const
+    {
+        if (_perspective) {
+            key = 1.0f / q(2);
+            x = q(0) * key * _sx + _cx;
+            y = q(1) * key * _sy + _cy;
+        }
+        else {
+            key = -q(2);
+            x = q(0) * _sx + _cx;
+            y = q(1) * _sy + _cy;
+        }
+    }
+
+    // Distance along the primary ray of pixel (x, y) from its depth key
+    float depth(int x, int y, float key) const
+    {
+        if (_perspective) {
+            const auto a = (x - _cx) / _sx;
+            const auto b = (y - _cy) / _sy;
+            return std::sqrt(1.0f + a * a + b * b) / key;
+        }
+        return -key;
+    }
+
+private:
+    bool _perspective;
+    float _near;
+    Eigen::Vector3f _pos;
+    Eigen::Vector3f _u;
+    Eigen::Vector3f _v;
+    Eigen::Vector3f _forward;
+    float _sx;
+    float _sy;
+    float _cx;
+    float _cy;
+};
+
+// A triangle in pixel coordinates
+struct _RasterTriangle
+{
+    // Edge functions a * x + b * y + c, all non-negative inside the triangle
+    float a[3];
+    float b[3];
+    float c[3];
+    // Depth key ka * x + kb * y + kc
+    float ka;
+    float kb;
+    float kc;
+    // Inclusive pixel bounds
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Clip a triangle in camera space against the near plane, the result is a
+// convex polygon of at most 4 vertices
+inline int _clip_near(const Eigen::Vector3f* in,
+                      float near,
+                      Eigen::Vector3f* out)
+{
+    int n = 0;
+    for (int i = 0; i < 3; ++i) {
+        const auto& p = in[i];
+        const auto& q = in[(i + 1) % 3];
+        const bool p_in = p(2) >= near;
+        const bool q_in = q(2) >= near;
+        if (p_in) { out[n++] = p; }
+        if (p_in != q_in) {
+            const auto t = (near - p(2)) / (q(2) - p(2));
+            out[n++] = p + t * (q - p);
+        }
+    }
+    return n;
+}
+
+// Set up a triangle from the pixel coordinates and keys of its vertices,
+// return false if it covers no pixel of the image
+inline bool _setup_triangle(const float* x,
+                            const float* y,
+                            const float* key,
+                            int width,
+                            int height,
+                            _RasterTriangle& tri)
+{
+    // Edge i is opposite to vertex i
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        const int k = (i + 2) % 3;
+        tri.a[i] = y[j] - y[k];
+        tri.b[i] = x[k] - x[j];
+        tri.c[i] = x[j] * y[k] - x[k] * y[j];
+    }
+    auto area = tri.a[0] * x[0] + tri.b[0] * y[0] + tri.c[0];
+    if (!std::isfinite(area) || area == 0.0f) { return false; }
+    // Both sides of triangles are visible
+    if (area < 0.0f) {
+        for (int i = 0; i < 3; ++i) {
+            tri.a[i] = -tri.a[i];
+            tri.b[i] = -tri.b[i];
+            tri.c[i] = -tri.c[i];
+        }
+        area = -area;
+    }
+
+    // Interpolate the keys by barycentric coordinates e_i / area
+    const auto rcp_area = 1.0f / area;
+    tri.ka = tri.kb = tri.kc = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        tri.ka += key[i] * tri.a[i] * rcp_area;
+        tri.kb += key[i] * tri.b[i] * rcp_area;
+        tri.kc += key[i] * tri.c[i] * rcp_area;
+    }
+
+    const auto [xmin, xmax] = std::minmax({ x[0], x[1], x[2] });
+    const auto [ymin, ymax] = std::minmax({ y[0], y[1], y[2] });
+    tri.x0 = static_cast<int>(std::ceil(std::max(xmin, 0.0f)));
+    tri.y0 = static_cast<int>(std::ceil(std::max(ymin, 0.0f)));
+    tri.x1 = static_cast<int>(std::floor(std::min(xmax, width - 1.0f)));
+    tri.y1 = static_cast<int>(std::floor(std::min(ymax, height - 1.0f)));
+    return tri.x0 <= tri.x1 && tri.y0 <= tri.y1;
+}
+
+// Rasterize a triangle into the buffers of the tile [x0, x1) x [y0, y1),
+// keys are only updated if given. The loops over the pixels of a group have
+// no branches so they are vectorized by the compiler.
+inline void _raster_tile(const _RasterTriangle& tri,
+                         int x0,
+                         int y0,
+                         int x1,
+                         int y1,
+                         float* keys,
+                         unsigned char* covered)
+{
+    const int bx0 = std::max(x0, tri.x0);
+    const int bx1 = std::min(x1 - 1, tri.x1);
+    const int by0 = std::max(y0, tri.y0);
+    const int by1 = std::min(y1 - 1, tri.y1);
+
+    for (int y = by0; y <= by1; ++y) {
+        const auto fy = static_cast<float>(y);
+        float row_e[3];
+        for (int i = 0; i < 3; ++i) {
+            row_e[i] = tri.b[i] * fy + tri.c[i];
+        }
+        const auto row_k = tri.kb * fy + tri.kc;
+        const int offset = (y - y0) * _raster_stride - x0;
+
+        for (int x = bx0; x <= bx1; x += _raster_lanes) {
+            alignas(32) unsigned char inside[_raster_lanes];
+            alignas(32) float k[_raster_lanes];
+            for (int l = 0; l < _raster_lanes; ++l) {
+                const auto fx = static_cast<float>(x + l);
+                const auto e0 = tri.a[0] * fx + row_e[0];
+                const auto e1 = tri.a[1] * fx + row_e[1];
+                const auto e2 = tri.a[2] * fx + row_e[2];
+                inside[l] = (e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f) &
+                            (x + l <= bx1);
+                k[l] = tri.ka * fx + row_k;
+            }
+
+            auto cov = covered + offset + x;
+            if (keys == nullptr) {
+                for (int l = 0; l < _raster_lanes; ++l) {
+                    cov[l] |= inside[l];
+                }
+                continue;
+            }
+            auto key = keys + offset + x;
+            for (int l = 0; l < _raster_lanes; ++l) {
+                const bool closer = inside[l] & (k[l] > key[l]);
+                key[l] = closer ? k[l] : key[l];
+                cov[l] |= inside[l];
+            }
+        }
+    }
+}
+
+} // namespace _impl
+
+inline Rasterizer::Rasterizer(int threads)
+    : _shared(_impl::_DeviceRegistry::instance().acquire(threads))
+{}
+
+template<typename FT, typename IT>
+void Rasterizer::attach_geometry(const std::vector<FT>& positions,
+                                 const std::vector<IT>& indices)
+{
+    if (indices.size() % 3 != 0) {
+        throw std::invalid_argument("Size of input indices is not divisible by "
+                                    "3, thus not a valid triangle mesh.");
+    }
+    _positions.resize(positions.size() / 3);
+    for (size_t i = 0; i < _positions.size(); ++i) {
+        _positions[i] << static_cast<float>(positions[3 * i + 0]),
+            static_cast<float>(positions[3 * i + 1]),
+            static_cast<float>(positions[3 * i + 2]);
+    }
+    _indices.assign(indices.begin(), indices.end());
+}
+
+inline void Rasterizer::release_geometry()
+{
+    _positions.clear();
+    _indices.clear();
+}
+
+template<typename T>
+void Rasterizer::render_depth(T* pixels,
+                              const Camera& camera,
+                              int width,
+                              int height,
+                              bool tone_mapped)
+{
+    _impl::_Projection projection(camera, width, height, 0.0f);
+    _rasterize(camera,
+               width,
+               height,
+               true,
+               [&](int x0,
+                   int y0,
+                   int x1,
+                   int y1,
+                   const float* keys,
+                   const unsigned char* covered) {
+                   for (int y = y0; y < y1; ++y) {
+                       for (int x = x0; x < x1; ++x) {
+                           const auto idx =
+                               (y - y0) * _impl::_raster_stride + x - x0;
+                           if (covered[idx] == 0) { continue; }
+                           auto depth = projection.depth(x, y, keys[idx]);
+                           auto& pixel = pixels[(height - y - 1) * width + x];
+                           if (tone_mapped) {
+                               auto value = depth / (depth + 1.0);
+                               pixel = static_cast<T>(value * 255);
+                           }
+                           else {
+                               pixel = static_cast<T>(depth);
+                           }
+                       }
+                   }
+               });
+}
+
+template<typename T>
+void Rasterizer::render_silhouette(T* pixels,
+                                   const Camera& camera,
+                                   int width,
+                                   int height)
+{
+    _rasterize(camera,
+               width,
+               height,
+               false,
+               [&](int x0,
+                   int y0,
+                   int x1,
+                   int y1,
+                   const float*,
+                   const unsigned char* covered) {
+                   for (int y = y0; y < y1; ++y) {
+                       for (int x = x0; x < x1; ++x) {
+                           const auto idx =
+                               (y - y0) * _impl::_raster_stride + x - x0;
+                           if (covered[idx] != 0) {
+                               pixels[(height - y - 1) * width + x] =
+                                   static_cast<T>(255);
+                           }
+                       }
+                   }
+               });
+}
+
+inline size_t Rasterizer::projected_area(const Camera& camera,
+                                         int width,
+                                         int height)
+{
+    std::atomic<size_t> area(0);
+    _rasterize(camera,
+               width,
+               height,
+               false,
+               [&](int x0,
+                   int y0,
+                   int x1,
+                   int y1,
+                   const float*,
+                   const unsigned char* covered) {
+                   size_t count = 0;
+                   for (int y = 0; y < y1 - y0; ++y) {
+                       for (int x = 0; x < x1 - x0; ++x) {
+                           count += covered[y * _impl::_raster_stride + x];
+                       }
+                   }
+                   area += count;
+               });
+    return area;
+}
+
+template<typename Func>
+void Rasterizer::_rasterize(const Camera& camera,
+                            int width,
+                            int height,
+                            bool depth,
+                            Func&& func)
+{
+    const int n_faces = static_cast<int>(_indices.size() / 3);
+    if (n_faces == 0) { return; }
+
+    // Clip against a plane slightly in front of a perspective camera, so the
+    // projection stays finite
+    Eigen::AlignedBox3f box;
+    for (const auto& p : _positions) {
+        box.extend(p);
+    }
+    _impl::_Projection projection(
+        camera, width, height, 1e-6f * box.diagonal().norm());
+
+    auto& scheduler = _shared->scheduler;
+    constexpr int size = _impl::_raster_tile_size;
+    const int tiles_x = (width + size - 1) / size;
+    const int tiles_y = (height + size - 1) / size;
+    const int tiles = tiles_x * tiles_y;
+
+    // Set up and bin the triangles in chunks, the bins of each chunk are
+    // separate so no locking is needed
+    const int chunks =
+        std::max(1, std::min(4 * scheduler.threads(), n_faces / 1024));
+    std::vector<std::vector<_impl::_RasterTriangle>> triangles(chunks);
+    std::vector<std::vector<int>> bins(chunks * tiles);
+    scheduler.run(chunks, [&](int chunk) {
+        const int begin =
+            static_cast<int>(static_cast<long long>(n_faces) * chunk / chunks);
+        const int end = static_cast<int>(static_cast<long long>(n_faces) *
+                                         (chunk + 1) / chunks);
+        auto& tris = triangles[chunk];
+        for (int f = begin; f < end; ++f) {
+            Eigen::Vector3f vertices[3];
+            for (int i = 0; i < 3; ++i) {
+                vertices[i] =
+                    projection.to_camera(_positions[_indices[3 * f + i]]);
+            }
+            Eigen::Vector3f polygon[4];
+            const int n =
+                _impl::_clip_near(vertices, projection.near(), polygon);
+
+            float x[4], y[4], key[4];
+            for (int i = 0; i < n; ++i) {
+                projection.project(polygon[i], x[i], y[i], key[i]);
+            }
+            for (int i = 1; i + 1 < n; ++i) {
+                const float tx[] = { x[0], x[i], x[i + 1] };
+                const float ty[] = { y[0], y[i], y[i + 1] };
+                const float tkey[] = { key[0], key[i], key[i + 1] };
+                _impl::_RasterTriangle tri;
+                if (!_impl::_setup_triangle(tx, ty, tkey, width, height, tri)) {
+                    continue;
+                }
+                const int id = static_cast<int>(tris.size());
+                tris.push_back(tri);
+                for (int ty = tri.y0 / size; ty <= tri.y1 / size; ++ty) {
+                    for (int tx = tri.x0 / size; tx <= tri.x1 / size; ++tx) {
+                        bins[chunk * tiles + ty * tiles_x + tx].push_back(id);
+                    }
+                }
+            }
+        }
+    });
+
+    // Rasterize the tiles in parallel, triangles keep their order in the mesh
+    scheduler.run(tiles, [&](int tile) {
+        const int x0 = (tile % tiles_x) * size;
+        const int y0 = (tile / tiles_x) * size;
+        const int x1 = std::min(x0 + size, width);
+        const int y1 = std::min(y0 + size, height);
+
+        alignas(32) float keys[size * _impl::_raster_stride];
+        alignas(32) unsigned char covered[size * _impl::_raster_stride];
+        std::fill(std::begin(keys),
+                  std::end(keys),
+                  -std::numeric_limits<float>::infinity());
+        std::fill(std::begin(covered), std::end(covered), 0);
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            for (auto id : bins[chunk * tiles + tile]) {
+                _impl::_raster_tile(triangles[chunk][id],
+                                    x0,
+                                    y0,
+                                    x1,
+                                    y1,
+                                    depth ? keys : nullptr,
+                                    covered);
+            }
+        }
+        func(x0, y0, x1, y1, keys, covered);
+    });
+}
+
+} // namespace Euclid
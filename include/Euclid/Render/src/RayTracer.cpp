@@ -1,12 +1,154 @@
 #include <algorithm>
 #include <string>
-#include <random>
+#include <type_traits>
 
+#include <Euclid/Render/PostProcess.h>
 #include <Euclid/Util/Assert.h>
 
+#include "CameraRays.h"
+#include "DeviceRegistry.h"
+#include "Sampling.h"
+#include "SceneCache.h"
+#include "TileScheduler.h"
+
 namespace Euclid
 {
 
+namespace _impl
+{
+
+// Split the images of a batch into tiles which are scheduled in parallel, and
+// invoke func on each packet of a tile with the index of its image
+template<typename Func>
+void _for_each_packet(_TileScheduler& scheduler,
+                      int views,
+                      int width,
+                      int height,
+                      Func&& func)
+{
+    const int tiles_x = (width + _tile_size - 1) / _tile_size;
+    const int tiles_y = (height + _tile_size - 1) / _tile_size;
+    const int tiles = tiles_x * tiles_y;
+    scheduler.run(views * tiles, [&](int item) {
+        const int view = item / tiles;
+        const int tile = item % tiles;
+        const int x0 = (tile % tiles_x) * _tile_size;
+        const int y0 = (tile / tiles_x) * _tile_size;
+        const int x1 = std::min(x0 + _tile_size, width);
+        const int y1 = std::min(y0 + _tile_size, height);
+        _Packet packet;
+        for (int py = y0; py < y1; py += _packet_height) {
+            for (int px = x0; px < x1; px += _packet_width) {
+                for (int i = 0; i < _packet_size; ++i) {
+                    packet.x[i] = px + i % _packet_width;
+                    packet.y[i] = py + i / _packet_width;
+                    packet.valid[i] =
+                        packet.x[i] < x1 && packet.y[i] < y1 ? -1 : 0;
+                }
+                func(view, packet);
+            }
+        }
+    });
+}
+
+// Process a single image
+template<typename Func>
+void _for_each_packet(_TileScheduler& scheduler,
+                      int width,
+                      int height,
+                      Func&& func)
+{
+    _for_each_packet(
+        scheduler, 1, width, height, [&func](int, const _Packet& packet) {
+            func(packet);
+        });
+}
+
+// Clamp a linear color and apply gamma correction, in range [0, 255]
+inline Eigen::Array3f _to_display(const Eigen::Array3f& color)
+{
+    // The table clamps the colors, NaN included
+    const auto& table = _display_table();
+    return Eigen::Array3f(table(color(0)), table(color(1)), table(color(2)));
+}
+
+// Write a linear color to pixel (x, y) of an image
+template<typename T>
+void _write_color(T* pixels,
+                  int width,
+                  int height,
+                  int x,
+                  int y,
+                  const Eigen::Array3f& color,
+                  bool interleaved)
+{
+    Eigen::Array3f value = _to_display(color);
+    auto r = _quantize<T>(value(0));
+    auto g = _quantize<T>(value(1));
+    auto b = _quantize<T>(value(2));
+    if (interleaved) {
+        pixels[3 * ((height - y - 1) * width + x) + 0] = r;
+        pixels[3 * ((height - y - 1) * width + x) + 1] = g;
+        pixels[3 * ((height - y - 1) * width + x) + 2] = b;
+    }
+    else {
+        pixels[(height - y - 1) * width + x] = r;
+        pixels[width * height + (height - y - 1) * width + x] = g;
+        pixels[2 * width * height + (height - y - 1) * width + x] = b;
+    }
+}
+
+// Post-process an image of linear colors on the render threads, in bands of
+// rows, counts could be null
+template<typename T>
+void _finalize(_TileScheduler& scheduler,
+               T* pixels,
+               const float* colors,
+               const int* counts,
+               int width,
+               int height,
+               bool interleaved)
+{
+    PostProcessOptions options;
+    options.interleaved = interleaved;
+    const auto& table = _display_table();
+    const int bands = (height + _tile_size - 1) / _tile_size;
+    scheduler.run(bands, [&](int band) {
+        const int first = band * _tile_size;
+        const int last = std::min(first + _tile_size, height);
+        _post_process_rows(pixels,
+                           colors,
+                           counts,
+                           width,
+                           height,
+                           first,
+                           last,
+                           table,
+                           options);
+    });
+}
+
+// Check the size of indices against the geometry type
+inline void _check_geometry(size_t n_indices, RTCGeometryType type)
+{
+    if (!(type == RTC_GEOMETRY_TYPE_TRIANGLE ||
+          type == RTC_GEOMETRY_TYPE_QUAD)) {
+        throw std::invalid_argument(
+            "Input type must be RTC_GEOMETRY_TYPE_TRIANGLE or "
+            "RTC_GEOMETRY_TYPE_QUAD.");
+    }
+    if (type == RTC_GEOMETRY_TYPE_TRIANGLE && n_indices % 3 != 0) {
+        throw std::invalid_argument("Size of input indices is not divisible by "
+                                    "3, thus not a valid triangle mesh.");
+    }
+    if (type == RTC_GEOMETRY_TYPE_QUAD && n_indices % 4 != 0) {
+        throw std::invalid_argument("Size of input indices is not divisible by "
+                                    "4, thus not a valid quad mesh.");
+    }
+}
+
+} // namespace _impl
+
 inline Camera::Camera(const Eigen::Vector3f& position,
                       const Eigen::Vector3f& focus,
                       const Eigen::Vector3f& up)
@@ -27,6 +169,24 @@ inline void Camera::lookat(const Eigen::Vector3f& position,
     v = dir.cross(u);
 }
 
+inline void Camera::gen_ray8(const float* s,
+                             const float* t,
+                             RTCRayHit8& rayhits,
+                             float near,
+                             float far) const
+{
+    for (int i = 0; i < 8; ++i) {
+        auto rayhit = gen_ray(s[i], t[i], near, far);
+        rayhits.ray.org_x[i] = rayhit.ray.org_x;
+        rayhits.ray.org_y[i] = rayhit.ray.org_y;
+        rayhits.ray.org_z[i] = rayhit.ray.org_z;
+        rayhits.ray.dir_x[i] = rayhit.ray.dir_x;
+        rayhits.ray.dir_y[i] = rayhit.ray.dir_y;
+        rayhits.ray.dir_z[i] = rayhit.ray.dir_z;
+        _impl::_init_rayhit8(rayhits, i, near, far);
+    }
+}
+
 inline PerspectiveCamera::PerspectiveCamera(const Eigen::Vector3f& position,
                                             const Eigen::Vector3f& focus,
                                             const Eigen::Vector3f& up,
@@ -60,7 +220,7 @@ inline RTCRayHit PerspectiveCamera::gen_ray(float s,
 {
     RTCRayHit rayhit;
     Eigen::Vector3f view =
-        -dir + (s - 0.5f) * film.width * u + (t - 0.5f) * film.height * v - pos;
+        -dir + (s - 0.5f) * film.width * u + (t - 0.5f) * film.height * v;
     EASSERT(view.dot(dir) < 0.0f);
 
     rayhit.ray.org_x = pos(0);
@@ -76,6 +236,25 @@ inline RTCRayHit PerspectiveCamera::gen_ray(float s,
     return rayhit;
 }
 
+inline void PerspectiveCamera::gen_ray8(const float* s,
+                                        const float* t,
+                                        RTCRayHit8& rayhits,
+                                        float near,
+                                        float far) const
+{
+    for (int i = 0; i < 8; ++i) {
+        auto a = (s[i] - 0.5f) * film.width;
+        auto b = (t[i] - 0.5f) * film.height;
+        rayhits.ray.org_x[i] = pos(0);
+        rayhits.ray.org_y[i] = pos(1);
+        rayhits.ray.org_z[i] = pos(2);
+        rayhits.ray.dir_x[i] = -dir(0) + a * u(0) + b * v(0);
+        rayhits.ray.dir_y[i] = -dir(1) + a * u(1) + b * v(1);
+        rayhits.ray.dir_z[i] = -dir(2) + a * u(2) + b * v(2);
+        _impl::_init_rayhit8(rayhits, i, near, far);
+    }
+}
+
 inline OrthogonalCamera::OrthogonalCamera(const Eigen::Vector3f& position,
                                           const Eigen::Vector3f& focus,
                                           const Eigen::Vector3f& up,
@@ -115,25 +294,87 @@ inline RTCRayHit OrthogonalCamera::gen_ray(float s,
     return rayhit;
 }
 
-inline RayTracer::RayTracer(int threads)
+inline void OrthogonalCamera::gen_ray8(const float* s,
+                                       const float* t,
+                                       RTCRayHit8& rayhits,
+                                       float near,
+                                       float far) const
 {
-    std::string cfg("threads=");
-    cfg.append(std::to_string(threads));
-    _device = rtcNewDevice(cfg.c_str());
-    if (!_device) {
-        auto err = rtcGetDeviceError(_device);
-        std::string err_str("Embree device creation error: ");
-        err_str.append(std::to_string(err));
-        throw std::runtime_error(err_str);
+    for (int i = 0; i < 8; ++i) {
+        auto a = (s[i] - 0.5f) * film.width;
+        auto b = (t[i] - 0.5f) * film.height;
+        rayhits.ray.org_x[i] = pos(0) + a * u(0) + b * v(0);
+        rayhits.ray.org_y[i] = pos(1) + a * u(1) + b * v(1);
+        rayhits.ray.org_z[i] = pos(2) + a * u(2) + b * v(2);
+        rayhits.ray.dir_x[i] = -dir(0);
+        rayhits.ray.dir_y[i] = -dir(1);
+        rayhits.ray.dir_z[i] = -dir(2);
+        _impl::_init_rayhit8(rayhits, i, near, far);
     }
+}
 
-    _scene = rtcNewScene(_device);
-    if (!_scene) {
-        auto err = rtcGetDeviceError(_device);
-        std::string err_str("Embree scene creation error: ");
-        err_str.append(std::to_string(err));
-        throw std::runtime_error(err_str);
+inline ColorMap::ColorMap(const std::vector<Eigen::Array3f>& colors, int size)
+{
+    if (colors.size() < 2 || size < 2) {
+        throw std::invalid_argument(
+            "A color map needs at least 2 colors and 2 entries.");
+    }
+    _lut.resize(size);
+    const float segments = static_cast<float>(colors.size() - 1);
+    for (int i = 0; i < size; ++i) {
+        const float t = segments * i / (size - 1);
+        const auto k = std::min(static_cast<size_t>(t), colors.size() - 2);
+        const float w = t - k;
+        _lut[i] = (1.0f - w) * colors[k] + w * colors[k + 1];
     }
+}
+
+inline ColorMap ColorMap::gray()
+{
+    return ColorMap({ Eigen::Array3f(0.0f, 0.0f, 0.0f),
+                      Eigen::Array3f(1.0f, 1.0f, 1.0f) });
+}
+
+inline ColorMap ColorMap::jet()
+{
+    return ColorMap({ Eigen::Array3f(0.0f, 0.0f, 0.5f),
+                      Eigen::Array3f(0.0f, 0.0f, 1.0f),
+                      Eigen::Array3f(0.0f, 0.5f, 1.0f),
+                      Eigen::Array3f(0.0f, 1.0f, 1.0f),
+                      Eigen::Array3f(0.5f, 1.0f, 0.5f),
+                      Eigen::Array3f(1.0f, 1.0f, 0.0f),
+                      Eigen::Array3f(1.0f, 0.5f, 0.0f),
+                      Eigen::Array3f(1.0f, 0.0f, 0.0f),
+                      Eigen::Array3f(0.5f, 0.0f, 0.0f) });
+}
+
+inline ColorMap ColorMap::viridis()
+{
+    // Sampled evenly from matplotlib's table
+    return ColorMap({ Eigen::Array3f(0.267f, 0.004f, 0.329f),
+                      Eigen::Array3f(0.278f, 0.176f, 0.482f),
+                      Eigen::Array3f(0.231f, 0.322f, 0.545f),
+                      Eigen::Array3f(0.173f, 0.447f, 0.557f),
+                      Eigen::Array3f(0.129f, 0.569f, 0.549f),
+                      Eigen::Array3f(0.157f, 0.682f, 0.502f),
+                      Eigen::Array3f(0.369f, 0.788f, 0.384f),
+                      Eigen::Array3f(0.678f, 0.863f, 0.188f),
+                      Eigen::Array3f(0.992f, 0.906f, 0.145f) });
+}
+
+inline Eigen::Array3f ColorMap::operator()(float value) const
+{
+    // NaN goes to the first entry as well
+    const float t = std::max(0.0f, std::min(value, 1.0f));
+    return _lut[static_cast<size_t>(t * (_lut.size() - 1) + 0.5f)];
+}
+
+inline RayTracer::RayTracer(int threads)
+    : _shared(_impl::_DeviceRegistry::instance().acquire(threads)),
+      _device(_shared->device),
+      _scheduler(&_shared->scheduler)
+{
+    _scene = _new_scene();
 
     _material.ambient << 0.1f, 0.1f, 0.1f;
     _material.diffuse << 0.7f, 0.7f, 0.7f;
@@ -142,7 +383,19 @@ inline RayTracer::RayTracer(int threads)
 inline RayTracer::~RayTracer()
 {
     rtcReleaseScene(_scene);
-    rtcReleaseDevice(_device);
+    for (auto prototype : _prototypes) {
+        rtcReleaseScene(prototype);
+    }
+}
+
+inline void RayTracer::set_concurrency(int threads)
+{
+    _impl::_DeviceRegistry::instance().set_concurrency(threads);
+}
+
+inline int RayTracer::concurrency()
+{
+    return _impl::_DeviceRegistry::instance().concurrency();
 }
 
 template<typename FT, typename IT>
@@ -154,32 +407,315 @@ void RayTracer::attach_geometry(const std::vector<FT>& positions,
         EWARNING("Input geometry is empty.");
         return;
     }
-    if (positions.size() % 3 != 0) {
+
+    // Release previously allocated geometry if presents
+    release_geometry();
+    auto id = _attach(_new_geometry(positions, indices, type));
+    _objects[id].vertices = positions.size() / 3;
+    commit();
+}
+
+inline void RayTracer::attach_geometry_shared(
+    const std::vector<float>& positions,
+    const std::vector<unsigned>& indices,
+    RTCGeometryType type)
+{
+    if (positions.empty() || indices.empty()) {
+        EWARNING("Input geometry is empty.");
+        return;
+    }
+
+    // Release previously allocated geometry if presents
+    release_geometry();
+    auto id = _attach(_new_geometry_shared(positions, indices, type));
+    _objects[id].vertices = positions.size() / 3;
+    _objects[id].shared = true;
+    commit();
+}
+
+template<typename FT, typename IT>
+unsigned RayTracer::add_geometry(const std::vector<FT>& positions,
+                                 const std::vector<IT>& indices,
+                                 RTCGeometryType type)
+{
+    auto id = _attach(_new_geometry(positions, indices, type));
+    _objects[id].vertices = positions.size() / 3;
+    return id;
+}
+
+inline unsigned RayTracer::add_geometry_shared(
+    const std::vector<float>& positions,
+    const std::vector<unsigned>& indices,
+    RTCGeometryType type)
+{
+    auto id = _attach(_new_geometry_shared(positions, indices, type));
+    _objects[id].vertices = positions.size() / 3;
+    _objects[id].shared = true;
+    return id;
+}
+
+template<typename FT, typename IT>
+unsigned RayTracer::add_prototype(const std::vector<FT>& positions,
+                                  const std::vector<IT>& indices,
+                                  RTCGeometryType type)
+{
+    auto geometry = _new_geometry(positions, indices, type);
+    auto prototype = _new_scene();
+    rtcAttachGeometry(prototype, geometry);
+    rtcReleaseGeometry(geometry);
+    rtcCommitScene(prototype);
+
+    _prototypes.push_back(prototype);
+    _cached.push_back(false);
+    return static_cast<unsigned>(_prototypes.size() - 1);
+}
+
+template<typename FT, typename IT>
+unsigned RayTracer::add_cached(const std::vector<FT>& positions,
+                               const std::vector<IT>& indices,
+                               RTCGeometryType type,
+                               const Eigen::Affine3f& transform)
+{
+    auto& cache = _impl::_SceneCache::instance();
+    const _impl::_SceneKey key{ _device,
+                                _impl::_hash_geometry(positions, indices, type),
+                                positions.size(),
+                                indices.size(),
+                                _scene_flags,
+                                _build_quality };
+    auto prototype = cache.find(key);
+    if (prototype == nullptr) {
+        auto geometry = _new_geometry(positions, indices, type);
+        prototype = _new_scene();
+        rtcAttachGeometry(prototype, geometry);
+        rtcReleaseGeometry(geometry);
+        rtcCommitScene(prototype);
+
+        const size_t face_size = type == RTC_GEOMETRY_TYPE_QUAD ? 4 : 3;
+        cache.insert(key,
+                     prototype,
+                     _impl::_SceneCache::estimate(positions.size() / 3,
+                                                  indices.size() / face_size,
+                                                  face_size));
+    }
+
+    _prototypes.push_back(prototype);
+    _cached.push_back(true);
+    return add_instance(static_cast<unsigned>(_prototypes.size() - 1),
+                        transform);
+}
+
+inline void RayTracer::set_cache_budget(size_t bytes)
+{
+    _impl::_SceneCache::instance().set_budget(bytes);
+}
+
+inline void RayTracer::clear_cache()
+{
+    _impl::_SceneCache::instance().clear();
+}
+
+inline unsigned RayTracer::add_instance(unsigned prototype,
+                                        const Eigen::Affine3f& transform)
+{
+    if (prototype >= _prototypes.size()) {
+        throw std::invalid_argument("Invalid prototype ID.");
+    }
+
+    auto geometry = rtcNewGeometry(_device, RTC_GEOMETRY_TYPE_INSTANCE);
+    rtcSetGeometryInstancedScene(geometry, _prototypes[prototype]);
+    rtcSetGeometryTimeStepCount(geometry, 1);
+    rtcSetGeometryTransform(geometry,
+                            0,
+                            RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                            transform.matrix().data());
+    rtcCommitGeometry(geometry);
+    auto id = _attach(geometry, transform.linear().inverse().transpose());
+    _objects[id].instance = true;
+    return id;
+}
+
+inline void RayTracer::set_transform(unsigned id,
+                                     const Eigen::Affine3f& transform)
+{
+    _check_id(id);
+    if (!_objects[id].instance) {
+        throw std::invalid_argument("Geometry is not an instance.");
+    }
+    auto geometry = rtcGetGeometry(_scene, id);
+    rtcSetGeometryTransform(geometry,
+                            0,
+                            RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                            transform.matrix().data());
+    rtcCommitGeometry(geometry);
+    _objects[id].normal_matrix = transform.linear().inverse().transpose();
+    _dirty = true;
+}
+
+template<typename FT>
+void RayTracer::update_positions(unsigned id,
+                                 const std::vector<FT>& positions)
+{
+    if (id >= _objects.size() || _objects[id].vertices == 0) {
+        throw std::invalid_argument("Invalid geometry ID.");
+    }
+    if (_objects[id].shared) {
         throw std::invalid_argument(
-            "Size of input positions is not divisible by 3.");
+            "Geometry uses a shared buffer, modify the buffer and call "
+            "update_positions(id) instead.");
     }
-    if (!(type == RTC_GEOMETRY_TYPE_TRIANGLE ||
-          type == RTC_GEOMETRY_TYPE_QUAD)) {
+    if (positions.size() != 3 * _objects[id].vertices) {
         throw std::invalid_argument(
-            "Input type must be RTC_GEOMETRY_TYPE_TRIANGLE or "
-            "RTC_GEOMETRY_TYPE_QUAD.");
+            "Size of input positions doesn't match the geometry.");
     }
-    if (type == RTC_GEOMETRY_TYPE_TRIANGLE && indices.size() % 3 != 0) {
-        throw std::invalid_argument("Size of input indices is not divisible by "
-                                    "3, thus not a valid triangle mesh.");
+
+    auto geometry = rtcGetGeometry(_scene, id);
+    auto vertices = reinterpret_cast<float*>(
+        rtcGetGeometryBufferData(geometry, RTC_BUFFER_TYPE_VERTEX, 0));
+    std::transform(positions.begin(), positions.end(), vertices, [](FT value) {
+        return static_cast<float>(value);
+    });
+    update_positions(id);
+}
+
+inline void RayTracer::update_positions(unsigned id)
+{
+    if (id >= _objects.size() || _objects[id].vertices == 0) {
+        throw std::invalid_argument("Invalid geometry ID.");
     }
-    if (type == RTC_GEOMETRY_TYPE_QUAD && indices.size() % 4 != 0) {
-        throw std::invalid_argument("Size of input indices is not divisible by "
-                                    "4, thus not a valid quad mesh.");
+
+    // Keep the topology of the BVH and only update its bounding boxes
+    auto geometry = rtcGetGeometry(_scene, id);
+    rtcSetGeometryBuildQuality(geometry, RTC_BUILD_QUALITY_REFIT);
+    rtcUpdateGeometryBuffer(geometry, RTC_BUFFER_TYPE_VERTEX, 0);
+    rtcCommitGeometry(geometry);
+    _dirty = true;
+}
+
+template<typename FT>
+void RayTracer::set_vertex_attribute(unsigned id,
+                                     const std::vector<FT>& values,
+                                     int channels)
+{
+    if (id >= _objects.size() || _objects[id].vertices == 0) {
+        throw std::invalid_argument("Invalid geometry ID.");
+    }
+    if (channels != 1 && channels != 3) {
+        throw std::invalid_argument("Number of channels must be 1 or 3.");
+    }
+    if (values.size() != channels * _objects[id].vertices) {
+        throw std::invalid_argument(
+            "Size of input values doesn't match the geometry.");
     }
 
-    // Release previously allocated geometry if presents
-    if (_geom_id != -1) { rtcDetachGeometry(_scene, _geom_id); }
+    auto geometry = rtcGetGeometry(_scene, id);
+    rtcSetGeometryVertexAttributeCount(geometry, 1);
+    auto attributes = reinterpret_cast<float*>(rtcSetNewGeometryBuffer(
+        geometry,
+        RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE,
+        0,
+        channels == 1 ? RTC_FORMAT_FLOAT : RTC_FORMAT_FLOAT3,
+        channels * sizeof(float),
+        _objects[id].vertices));
+    std::transform(values.begin(), values.end(), attributes, [](FT value) {
+        return static_cast<float>(value);
+    });
+    rtcCommitGeometry(geometry);
+    _objects[id].attribute_channels = channels;
+    _dirty = true;
+}
 
-    _geometry = rtcNewGeometry(_device, type);
+inline void RayTracer::release_geometry(unsigned id)
+{
+    _check_id(id);
+    rtcDetachGeometry(_scene, id);
+    // Later calls with this ID are rejected until it is reused
+    _objects[id].attached = false;
+    _objects[id].vertices = 0;
+    _dirty = true;
+}
+
+inline void RayTracer::release_geometry()
+{
+    // A fresh scene also restarts the geometry IDs from 0
+    rtcReleaseScene(_scene);
+    _scene = _new_scene();
+    for (auto prototype : _prototypes) {
+        rtcReleaseScene(prototype);
+    }
+    _prototypes.clear();
+    _cached.clear();
+    _objects.clear();
+    _dirty = true;
+}
+
+inline void RayTracer::set_material(const Material& material)
+{
+    _material = material;
+    for (auto& object : _objects) {
+        object.material = material;
+    }
+}
+
+inline void RayTracer::set_material(unsigned id, const Material& material)
+{
+    _check_id(id);
+    _objects[id].material = material;
+}
+
+inline void RayTracer::set_scene_flags(RTCSceneFlags flags)
+{
+    _scene_flags = flags;
+    rtcSetSceneFlags(_scene, flags);
+    for (size_t i = 0; i < _prototypes.size(); ++i) {
+        // Cached prototypes are shared with other ray tracers, which could
+        // be tracing them right now
+        if (_cached[i]) { continue; }
+        rtcSetSceneFlags(_prototypes[i], flags);
+        rtcCommitScene(_prototypes[i]);
+    }
+    _dirty = true;
+}
+
+inline void RayTracer::set_build_quality(RTCBuildQuality quality)
+{
+    _build_quality = quality;
+    rtcSetSceneBuildQuality(_scene, quality);
+    _dirty = true;
+}
+
+inline void RayTracer::commit()
+{
+    if (_dirty) {
+        rtcCommitScene(_scene);
+        _dirty = false;
+    }
+}
+
+inline RTCScene RayTracer::scene()
+{
+    commit();
+    return _scene;
+}
+
+template<typename FT, typename IT>
+RTCGeometry RayTracer::_new_geometry(const std::vector<FT>& positions,
+                                     const std::vector<IT>& indices,
+                                     RTCGeometryType type)
+{
+    if (positions.empty() || indices.empty()) {
+        throw std::invalid_argument("Input geometry is empty.");
+    }
+    if (positions.size() % 3 != 0) {
+        throw std::invalid_argument(
+            "Size of input positions is not divisible by 3.");
+    }
+    _impl::_check_geometry(indices.size(), type);
+
+    auto geometry = rtcNewGeometry(_device, type);
 
     auto vertices =
-        reinterpret_cast<float*>(rtcSetNewGeometryBuffer(_geometry,
+        reinterpret_cast<float*>(rtcSetNewGeometryBuffer(geometry,
                                                          RTC_BUFFER_TYPE_VERTEX,
                                                          0,
                                                          RTC_FORMAT_FLOAT3,
@@ -192,7 +728,7 @@ void RayTracer::attach_geometry(const std::vector<FT>& positions,
     unsigned* faces = nullptr;
     if (type == RTC_GEOMETRY_TYPE_TRIANGLE) {
         faces = reinterpret_cast<unsigned*>(
-            rtcSetNewGeometryBuffer(_geometry,
+            rtcSetNewGeometryBuffer(geometry,
                                     RTC_BUFFER_TYPE_INDEX,
                                     0,
                                     RTC_FORMAT_UINT3,
@@ -201,7 +737,7 @@ void RayTracer::attach_geometry(const std::vector<FT>& positions,
     }
     else { // type == RTC_GEOMETRY_TYPE_QUAD
         faces = reinterpret_cast<unsigned*>(
-            rtcSetNewGeometryBuffer(_geometry,
+            rtcSetNewGeometryBuffer(geometry,
                                     RTC_BUFFER_TYPE_INDEX,
                                     0,
                                     RTC_FORMAT_UINT4,
@@ -212,48 +748,30 @@ void RayTracer::attach_geometry(const std::vector<FT>& positions,
         return static_cast<unsigned>(value);
     });
 
-    rtcCommitGeometry(_geometry);
-    _geom_id = rtcAttachGeometry(_scene, _geometry);
-    rtcReleaseGeometry(_geometry);
-    rtcCommitScene(_scene);
+    rtcSetGeometryBuildQuality(geometry, _build_quality);
+    rtcCommitGeometry(geometry);
+    return geometry;
 }
 
 // TODO: add generic type support
-inline void RayTracer::attach_geometry_shared(
+inline RTCGeometry RayTracer::_new_geometry_shared(
     const std::vector<float>& positions,
     const std::vector<unsigned>& indices,
     RTCGeometryType type)
 {
     if (positions.empty() || indices.empty()) {
-        EWARNING("Input geometry is empty.");
-        return;
+        throw std::invalid_argument("Input geometry is empty.");
     }
     if (positions.size() % 3 != 1) {
         throw std::invalid_argument("The last element of the positions buffer "
                                     "is not padded to 16 bytes, add "
                                     "one more 0.0f to your positions buffer.");
     }
-    if (!(type == RTC_GEOMETRY_TYPE_TRIANGLE ||
-          type == RTC_GEOMETRY_TYPE_QUAD)) {
-        throw std::invalid_argument(
-            "Input type must be RTC_GEOMETRY_TYPE_TRIANGLE or "
-            "RTC_GEOMETRY_TYPE_QUAD.");
-    }
-    if (type == RTC_GEOMETRY_TYPE_TRIANGLE && indices.size() % 3 != 0) {
-        throw std::invalid_argument("Size of input indices is not divisible by "
-                                    "3, thus not a valid triangle mesh.");
-    }
-    if (type == RTC_GEOMETRY_TYPE_QUAD && indices.size() % 4 != 0) {
-        throw std::invalid_argument("Size of input indices is not divisible by "
-                                    "4, thus not a valid quad mesh.");
-    }
+    _impl::_check_geometry(indices.size(), type);
 
-    // Release previously allocated geometry if presents
-    if (_geom_id != -1) { rtcDetachGeometry(_scene, _geom_id); }
-
-    _geometry = rtcNewGeometry(_device, type);
+    auto geometry = rtcNewGeometry(_device, type);
 
-    rtcSetSharedGeometryBuffer(_geometry,
+    rtcSetSharedGeometryBuffer(geometry,
                                RTC_BUFFER_TYPE_VERTEX,
                                0,
                                RTC_FORMAT_FLOAT3,
@@ -263,7 +781,7 @@ inline void RayTracer::attach_geometry_shared(
                                positions.size() / 3);
 
     if (type == RTC_GEOMETRY_TYPE_TRIANGLE) {
-        rtcSetSharedGeometryBuffer(_geometry,
+        rtcSetSharedGeometryBuffer(geometry,
                                    RTC_BUFFER_TYPE_INDEX,
                                    0,
                                    RTC_FORMAT_UINT3,
@@ -273,7 +791,7 @@ inline void RayTracer::attach_geometry_shared(
                                    indices.size() / 3);
     }
     else { // type == RTC_GEOMETRY_TYPE_QUAD
-        rtcSetSharedGeometryBuffer(_geometry,
+        rtcSetSharedGeometryBuffer(geometry,
                                    RTC_BUFFER_TYPE_INDEX,
                                    0,
                                    RTC_FORMAT_UINT4,
@@ -283,23 +801,84 @@ inline void RayTracer::attach_geometry_shared(
                                    indices.size() / 4);
     }
 
-    rtcCommitGeometry(_geometry);
-    _geom_id = rtcAttachGeometry(_scene, _geometry);
-    rtcReleaseGeometry(_geometry);
-    rtcCommitScene(_scene);
+    rtcSetGeometryBuildQuality(geometry, _build_quality);
+    rtcCommitGeometry(geometry);
+    return geometry;
 }
 
-inline void RayTracer::release_geometry()
+inline RTCScene RayTracer::_new_scene()
 {
-    if (_geom_id != -1) {
-        rtcDetachGeometry(_scene, _geom_id);
-        _geom_id = -1;
+    auto scene = rtcNewScene(_device);
+    if (!scene) {
+        auto err = rtcGetDeviceError(_device);
+        std::string err_str("Embree scene creation error: ");
+        err_str.append(std::to_string(err));
+        throw std::runtime_error(err_str);
     }
+    rtcSetSceneFlags(scene, _scene_flags);
+    rtcSetSceneBuildQuality(scene, _build_quality);
+    return scene;
 }
 
-inline void RayTracer::set_material(const Material& material)
+inline void RayTracer::_check_id(unsigned id) const
 {
-    _material = material;
+    if (id >= _objects.size() || !_objects[id].attached) {
+        throw std::invalid_argument("Invalid geometry ID.");
+    }
+}
+
+inline unsigned RayTracer::_attach(RTCGeometry geometry,
+                                   const Eigen::Matrix3f& normal_matrix)
+{
+    auto id = rtcAttachGeometry(_scene, geometry);
+    rtcReleaseGeometry(geometry);
+    if (id >= _objects.size()) { _objects.resize(id + 1); }
+    // IDs of released geometries are reused
+    auto& object = _objects[id];
+    object.material = _material;
+    object.normal_matrix = normal_matrix;
+    object.vertices = 0;
+    object.shared = false;
+    object.attribute_channels = 0;
+    object.instance = false;
+    object.attached = true;
+    _dirty = true;
+    return id;
+}
+
+inline unsigned RayTracer::_hit_id(const RTCRayHit8& rayhits, int i)
+{
+    return rayhits.hit.instID[0][i] != RTC_INVALID_GEOMETRY_ID
+               ? rayhits.hit.instID[0][i]
+               : rayhits.hit.geomID[i];
+}
+
+inline Eigen::Vector3f RayTracer::_hit_normal(const RTCRayHit8& rayhits,
+                                              int i) const
+{
+    // Instance hits report normals in object space
+    const auto& object = _objects[_hit_id(rayhits, i)];
+    Eigen::Vector3f normal =
+        object.normal_matrix * Eigen::Vector3f(rayhits.hit.Ng_x[i],
+                                               rayhits.hit.Ng_y[i],
+                                               rayhits.hit.Ng_z[i]);
+    return normal.normalized();
+}
+
+inline Eigen::Array3f RayTracer::_shade(const RTCRayHit8& rayhits,
+                                        int i) const
+{
+    const auto& material = _objects[_hit_id(rayhits, i)].material;
+    auto normal = _hit_normal(rayhits, i);
+    // Point light at the view position
+    Eigen::Vector3f lightdir(
+        rayhits.ray.dir_x[i], rayhits.ray.dir_y[i], rayhits.ray.dir_z[i]);
+    lightdir.normalize();
+
+    Eigen::Array3f ambient = material.ambient;
+    Eigen::Array3f diffuse =
+        material.diffuse * std::abs(normal.dot(-lightdir));
+    return ambient + diffuse;
 }
 
 template<typename T>
@@ -308,135 +887,888 @@ void RayTracer::render_shaded(T* pixels,
                               int width,
                               int height,
                               int samples,
-                              bool interleaved)
+                              bool interleaved,
+                              unsigned seed)
+{
+    std::vector<float> colors(3 * width * height);
+    render_linear(colors.data(), camera, width, height, samples, seed);
+    _impl::_finalize(*_scheduler,
+                     pixels,
+                     colors.data(),
+                     nullptr,
+                     width,
+                     height,
+                     interleaved);
+}
+
+inline void RayTracer::render_linear(float* colors,
+                                     const Camera& camera,
+                                     int width,
+                                     int height,
+                                     int samples,
+                                     unsigned seed)
+{
+    commit();
+    _impl::_visit_camera(camera, width, height, [&](const auto& rays) {
+        _impl::_for_each_packet(
+            *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+                Eigen::Array3f values[_impl::_packet_size];
+                _trace_shaded(packet, values, rays, width, samples, seed);
+                for (int i = 0; i < _impl::_packet_size; ++i) {
+                    if (packet.valid[i] == 0) { continue; }
+                    const auto idx = packet.y[i] * width + packet.x[i];
+                    colors[3 * idx + 0] = values[i](0);
+                    colors[3 * idx + 1] = values[i](1);
+                    colors[3 * idx + 2] = values[i](2);
+                }
+            });
+    });
+}
+
+template<typename T>
+void RayTracer::render_depth(T* pixels,
+                             const Camera& camera,
+                             int width,
+                             int height,
+                             bool tone_mapped)
+{
+    commit();
+    _impl::_visit_camera(camera, width, height, [&](const auto& rays) {
+        _impl::_for_each_packet(
+            *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+                _trace_depth(
+                    packet, pixels, rays, width, height, tone_mapped);
+            });
+    });
+}
+
+template<typename T>
+void RayTracer::render_silhouette(T* pixels,
+                                  const Camera& camera,
+                                  int width,
+                                  int height)
+{
+    commit();
+    _impl::_visit_camera(camera, width, height, [&](const auto& rays) {
+        _impl::_for_each_packet(
+            *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+                _trace_silhouette(packet, pixels, rays, width, height);
+            });
+    });
+}
+
+inline void RayTracer::render_face_id(unsigned* pixels,
+                                      const Camera& camera,
+                                      int width,
+                                      int height)
 {
+    commit();
+    _impl::_visit_camera(camera, width, height, [&](const auto& rays) {
+        _impl::_for_each_packet(
+            *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+                _trace_face_id(packet, pixels, rays, width, height);
+            });
+    });
+}
+
+template<typename T>
+void RayTracer::render_attribute(T* pixels,
+                                 const Camera& camera,
+                                 int width,
+                                 int height,
+                                 const ColorMap& colormap,
+                                 float min,
+                                 float max,
+                                 bool shaded,
+                                 bool interleaved)
+{
+    if (!(max > min)) {
+        throw std::invalid_argument("Invalid range of attribute values.");
+    }
+    commit();
+    _impl::_visit_camera(camera, width, height, [&](const auto& rays) {
+        _impl::_for_each_packet(
+            *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+                _trace_attribute(packet,
+                                 pixels,
+                                 rays,
+                                 width,
+                                 height,
+                                 colormap,
+                                 min,
+                                 max,
+                                 shaded,
+                                 interleaved);
+            });
+    });
+}
+
+template<typename T>
+float RayTracer::render_shaded(T* pixels,
+                               const Camera& camera,
+                               int width,
+                               int height,
+                               const AdaptiveSampling& sampling,
+                               bool interleaved,
+                               unsigned seed)
+{
+    if (sampling.min_samples < 2 ||
+        sampling.max_samples < sampling.min_samples) {
+        throw std::invalid_argument(
+            "Adaptive sampling needs 2 <= min_samples <= max_samples.");
+    }
+    commit();
+
     RTCIntersectContext context;
     rtcInitIntersectContext(&context);
-    std::random_device rd;
-    std::minstd_rand rd_gen(rd());
-    std::uniform_real_distribution<> rd_number(0.0f, 1.0f);
-    float rcpr_samples = 1.0f / samples;
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+    const auto camera_rays = _impl::_camera_rays(camera, width, height);
+    const int n_pixels = width * height;
 
-#pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            Eigen::Array3f color(0.0f, 0.0f, 0.0f);
-            for (int s = 0; s < samples; ++s) {
-                auto u = static_cast<float>(x + rd_number(rd_gen)) / width;
-                auto v = static_cast<float>(y + rd_number(rd_gen)) / height;
-                auto rayhit = camera.gen_ray(u, v);
-                rtcIntersect1(_scene, &context, &rayhit);
-
-                if (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID) {
-                    Eigen::Vector3f normal = Eigen::Vector3f(rayhit.hit.Ng_x,
-                                                             rayhit.hit.Ng_y,
-                                                             rayhit.hit.Ng_z)
-                                                 .normalized();
-                    // Point light at the view position
-                    Eigen::Vector3f lightdir = Eigen::Vector3f(rayhit.ray.dir_x,
-                                                               rayhit.ray.dir_y,
-                                                               rayhit.ray.dir_z)
-                                                   .normalized();
-
-                    Eigen::Array3f ambient = _material.ambient;
-                    Eigen::Array3f diffuse =
-                        _material.diffuse * std::abs(normal.dot(-lightdir));
-                    color += ambient + diffuse;
-                }
+    // Accumulated colors, squared luminances and number of samples of each
+    // pixel, and whether the samples of a pixel see different geometries
+    std::vector<Eigen::Array3f> colors(n_pixels, Eigen::Array3f::Zero());
+    std::vector<float> squares(n_pixels, 0.0f);
+    std::vector<int> counts(n_pixels, 0);
+    std::vector<unsigned char> edges(n_pixels, 0);
+
+    // Trace samples [first, last) of a packet of pixels, which need not be
+    // neighbors
+    auto trace = [&](const auto& rays,
+                     const _impl::_Packet& packet,
+                     int first,
+                     int last) {
+        unsigned ids[_impl::_packet_size];
+        for (int s = first; s < last; ++s) {
+            float xs[_impl::_packet_size];
+            float ys[_impl::_packet_size];
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                float ds, dt;
+                _impl::_progressive_sample(
+                    seed, packet.y[i] * width + packet.x[i], s, ds, dt);
+                xs[i] = packet.x[i] + ds;
+                ys[i] = packet.y[i] + dt;
             }
-            color *= rcpr_samples;
-            color(0) = std::min(color(0), 1.0f);
-            color(1) = std::min(color(1), 1.0f);
-            color(2) = std::min(color(2), 1.0f);
-            const float gamma = 1.0f / 2.2f;
-            color = color.pow(gamma);
-            color *= 255;
-            auto r = static_cast<T>(color(0));
-            auto g = static_cast<T>(color(1));
-            auto b = static_cast<T>(color(2));
-            if (interleaved) {
-                pixels[3 * ((height - y - 1) * width + x) + 0] = r;
-                pixels[3 * ((height - y - 1) * width + x) + 1] = g;
-                pixels[3 * ((height - y - 1) * width + x) + 2] = b;
+            RTCRayHit8 rayhits;
+            rays(xs, ys, rayhits);
+            rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                if (packet.valid[i] == 0) { continue; }
+                const auto idx = packet.y[i] * width + packet.x[i];
+                const bool hit =
+                    rayhits.hit.geomID[i] != RTC_INVALID_GEOMETRY_ID;
+                const auto id = hit ? _hit_id(rayhits, i)
+                                    : RTC_INVALID_GEOMETRY_ID;
+                if (s == first) { ids[i] = id; }
+                if (id != ids[i]) { edges[idx] = 1; }
+                if (!hit) { continue; }
+                Eigen::Array3f color = _shade(rayhits, i);
+                const auto luminance = 0.2126f * color(0) +
+                                       0.7152f * color(1) +
+                                       0.0722f * color(2);
+                colors[idx] += color;
+                squares[idx] += luminance * luminance;
             }
-            else {
-                pixels[(height - y - 1) * width + x] = r;
-                pixels[width * height + (height - y - 1) * width + x] = g;
-                pixels[2 * width * height + (height - y - 1) * width + x] = b;
+        }
+        for (int i = 0; i < _impl::_packet_size; ++i) {
+            if (packet.valid[i] == 0) { continue; }
+            counts[packet.y[i] * width + packet.x[i]] += last - first;
+        }
+    };
+
+    // Trace the first samples of all pixels
+    std::visit(
+        [&](const auto& rays) {
+            _impl::_for_each_packet(
+                *_scheduler,
+                width,
+                height,
+                [&](const _impl::_Packet& packet) {
+                    trace(rays, packet, 0, sampling.min_samples);
+                });
+        },
+        camera_rays);
+
+    // Find the pixels to refine in scanline order, so that packets of them
+    // stay coherent. The few first samples may all miss an edge crossing a
+    // pixel, so the neighbors of edge pixels are refined as well.
+    std::vector<int> refined;
+    const auto threshold2 = sampling.threshold * sampling.threshold;
+    auto near_edge = [&](int idx) {
+        const int x = idx % width;
+        const int y = idx / width;
+        for (int j = std::max(y - 1, 0); j <= std::min(y + 1, height - 1);
+             ++j) {
+            for (int i = std::max(x - 1, 0); i <= std::min(x + 1, width - 1);
+                 ++i) {
+                if (edges[j * width + i] != 0) { return true; }
             }
         }
+        return false;
+    };
+    for (int idx = 0; idx < n_pixels; ++idx) {
+        const auto n = static_cast<float>(counts[idx]);
+        const auto c = colors[idx];
+        const auto mean =
+            (0.2126f * c(0) + 0.7152f * c(1) + 0.0722f * c(2)) / n;
+        const auto variance =
+            std::max(0.0f, squares[idx] / n - mean * mean) * n / (n - 1.0f);
+        if (near_edge(idx) || variance / n > threshold2) {
+            refined.push_back(idx);
+        }
+    }
+
+    // Spread the extra samples allowed by the budget evenly
+    int extra = sampling.max_samples - sampling.min_samples;
+    if (sampling.budget > 0.0f && !refined.empty()) {
+        const auto allowed = std::max(
+            0.0, (static_cast<double>(sampling.budget) - sampling.min_samples) *
+                     n_pixels);
+        extra = static_cast<int>(std::min<double>(
+            extra, std::floor(allowed / refined.size())));
+    }
+
+    if (extra > 0) {
+        const int packets = static_cast<int>(
+            (refined.size() + _impl::_packet_size - 1) / _impl::_packet_size);
+        std::visit(
+            [&](const auto& rays) {
+                _scheduler->run(packets, [&](int p) {
+                    _impl::_Packet packet;
+                    for (int i = 0; i < _impl::_packet_size; ++i) {
+                        const size_t k = p * _impl::_packet_size + i;
+                        const auto idx = k < refined.size() ? refined[k] : 0;
+                        packet.x[i] = idx % width;
+                        packet.y[i] = idx / width;
+                        packet.valid[i] = k < refined.size() ? -1 : 0;
+                    }
+                    trace(rays,
+                          packet,
+                          sampling.min_samples,
+                          sampling.min_samples + extra);
+                });
+            },
+            camera_rays);
     }
+
+    _impl::_finalize(*_scheduler,
+                     pixels,
+                     colors[0].data(),
+                     counts.data(),
+                     width,
+                     height,
+                     interleaved);
+    const auto total = static_cast<double>(sampling.min_samples) * n_pixels +
+                       static_cast<double>(std::max(extra, 0)) * refined.size();
+    return static_cast<float>(total / n_pixels);
 }
 
 template<typename T>
-void RayTracer::render_depth(T* pixels,
-                             const Camera& camera,
+int RayTracer::render_progressive(T* pixels,
+                                  const Camera& camera,
+                                  int width,
+                                  int height,
+                                  int max_samples,
+                                  std::chrono::milliseconds budget,
+                                  bool interleaved,
+                                  unsigned seed,
+                                  const std::function<void(int)>& callback)
+{
+    commit();
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + budget;
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    // Accumulated colors and number of samples of each pixel
+    std::vector<Eigen::Array3f> colors(width * height, Eigen::Array3f::Zero());
+    std::vector<int> counts(width * height, 0);
+
+    // Passes of 1, 1, 2, 4... samples, each doubles the samples of a pixel
+    const auto camera_rays = _impl::_camera_rays(camera, width, height);
+    int samples = 0;
+    while (samples < max_samples) {
+        const int first = samples;
+        const int n = std::min(std::max(samples, 1), max_samples - samples);
+        auto trace = [&](const auto& rays, const _impl::_Packet& packet) {
+            // Always finish the first pass, then stop at the deadline
+            int s = first;
+            for (; s < first + n; ++s) {
+                if (first > 0 && Clock::now() >= deadline) { break; }
+                float xs[_impl::_packet_size];
+                float ys[_impl::_packet_size];
+                for (int i = 0; i < _impl::_packet_size; ++i) {
+                    float ds, dt;
+                    _impl::_progressive_sample(
+                        seed, packet.y[i] * width + packet.x[i], s, ds, dt);
+                    xs[i] = packet.x[i] + ds;
+                    ys[i] = packet.y[i] + dt;
+                }
+                RTCRayHit8 rayhits;
+                rays(xs, ys, rayhits);
+                rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+                for (int i = 0; i < _impl::_packet_size; ++i) {
+                    if (packet.valid[i] == 0 ||
+                        rayhits.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+                        continue;
+                    }
+                    colors[packet.y[i] * width + packet.x[i]] +=
+                        _shade(rayhits, i);
+                }
+            }
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                if (packet.valid[i] == 0) { continue; }
+                counts[packet.y[i] * width + packet.x[i]] += s - first;
+            }
+        };
+        std::visit(
+            [&](const auto& rays) {
+                _impl::_for_each_packet(
+                    *_scheduler,
+                    width,
+                    height,
+                    [&](const _impl::_Packet& packet) { trace(rays, packet); });
+            },
+            camera_rays);
+        samples += n;
+
+        // Update the image with the samples traced so far
+        _impl::_finalize(*_scheduler,
+                         pixels,
+                         colors[0].data(),
+                         counts.data(),
+                         width,
+                         height,
+                         interleaved);
+        if (callback) { callback(samples); }
+        if (Clock::now() >= deadline) { break; }
+    }
+    return *std::min_element(counts.begin(), counts.end());
+}
+
+template<typename CameraT, typename T>
+void RayTracer::render_views(T* pixels,
+                             const std::vector<CameraT>& cameras,
                              int width,
                              int height,
-                             bool tone_mapped)
+                             RenderMode mode,
+                             int samples)
+{
+    // Depth and face indices would be silently truncated by narrow types
+    if (mode == RenderMode::depth && !std::is_floating_point_v<T>) {
+        throw std::invalid_argument(
+            "Depth images require floating point pixels.");
+    }
+    if (mode == RenderMode::face_id &&
+        !(std::is_integral_v<T> && sizeof(T) >= sizeof(unsigned))) {
+        throw std::invalid_argument(
+            "Face index images require integral pixels of at least 32 bits.");
+    }
+    commit();
+    const int views = static_cast<int>(cameras.size());
+    const size_t channels = mode == RenderMode::shaded ? 3 : 1;
+    const size_t stride = channels * width * height;
+    // Resolve the camera type of each view before tracing
+    std::vector<_impl::_CameraRays> camera_rays;
+    camera_rays.reserve(views);
+    for (const Camera& camera : cameras) {
+        camera_rays.push_back(_impl::_camera_rays(camera, width, height));
+    }
+    _impl::_for_each_packet(
+        *_scheduler,
+        views,
+        width,
+        height,
+        [&](int view, const _impl::_Packet& packet) {
+            auto image = pixels + view * stride;
+            std::visit(
+                [&](const auto& rays) {
+                    switch (mode) {
+                    case RenderMode::shaded: {
+                        // A float buffer of every view would take too much
+                        // memory, so pixels are converted one by one
+                        Eigen::Array3f colors[_impl::_packet_size];
+                        _trace_shaded(packet, colors, rays, width, samples, 0);
+                        for (int i = 0; i < _impl::_packet_size; ++i) {
+                            if (packet.valid[i] == 0) { continue; }
+                            _impl::_write_color(image,
+                                                width,
+                                                height,
+                                                packet.x[i],
+                                                packet.y[i],
+                                                colors[i],
+                                                true);
+                        }
+                        break;
+                    }
+                    case RenderMode::depth:
+                        _trace_depth(
+                            packet, image, rays, width, height, false);
+                        break;
+                    case RenderMode::silhouette:
+                        _trace_silhouette(packet, image, rays, width, height);
+                        break;
+                    case RenderMode::face_id:
+                        _trace_face_id(packet, image, rays, width, height);
+                        break;
+                    }
+                },
+                camera_rays[view]);
+        });
+}
+
+inline void RayTracer::render_gbuffer(const GBuffer& gbuffer,
+                                      const Camera& camera,
+                                      int width,
+                                      int height)
+{
+    commit();
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+    const Eigen::Vector3f forward = -camera.dir.normalized();
+
+    const auto camera_rays = _impl::_camera_rays(camera, width, height);
+    _impl::_for_each_packet(
+        *_scheduler, width, height, [&](const _impl::_Packet& packet) {
+            RTCRayHit8 rayhits;
+            std::visit([&](const auto& rays) { rays(packet, rayhits); },
+                       camera_rays);
+            rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+            // The color is traced separately at the jittered sample of
+            // render_shaded(), the other channels are at pixel centers
+            Eigen::Array3f colors[_impl::_packet_size];
+            if (gbuffer.color != nullptr) {
+                std::visit(
+                    [&](const auto& rays) {
+                        _trace_shaded(packet, colors, rays, width, 1, 0);
+                    },
+                    camera_rays);
+            }
+
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                if (packet.valid[i] == 0) { continue; }
+                const auto idx =
+                    (height - packet.y[i] - 1) * width + packet.x[i];
+                const bool hit =
+                    rayhits.hit.geomID[i] != RTC_INVALID_GEOMETRY_ID;
+
+                if (gbuffer.depth != nullptr) {
+                    float depth = 0.0f;
+                    if (hit) {
+                        Eigen::Vector3f dir(rayhits.ray.dir_x[i],
+                                            rayhits.ray.dir_y[i],
+                                            rayhits.ray.dir_z[i]);
+                        depth = gbuffer.depth_type == DepthType::linear
+                                    ? rayhits.ray.tfar[i] * dir.dot(forward)
+                                    : rayhits.ray.tfar[i] * dir.norm();
+                    }
+                    gbuffer.depth[idx] = depth;
+                }
+                if (gbuffer.normal != nullptr) {
+                    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+                    if (hit) { normal = _hit_normal(rayhits, i); }
+                    gbuffer.normal[3 * idx + 0] = normal(0);
+                    gbuffer.normal[3 * idx + 1] = normal(1);
+                    gbuffer.normal[3 * idx + 2] = normal(2);
+                }
+                if (gbuffer.primitive != nullptr) {
+                    gbuffer.primitive[idx] =
+                        hit ? rayhits.hit.primID[i] : RTC_INVALID_GEOMETRY_ID;
+                }
+                if (gbuffer.geometry != nullptr) {
+                    gbuffer.geometry[idx] =
+                        hit ? _hit_id(rayhits, i) : RTC_INVALID_GEOMETRY_ID;
+                }
+                if (gbuffer.barycentric != nullptr) {
+                    gbuffer.barycentric[2 * idx + 0] =
+                        hit ? rayhits.hit.u[i] : 0.0f;
+                    gbuffer.barycentric[2 * idx + 1] =
+                        hit ? rayhits.hit.v[i] : 0.0f;
+                }
+                if (gbuffer.mask != nullptr) {
+                    gbuffer.mask[idx] = hit ? 255 : 0;
+                }
+                if (gbuffer.color != nullptr) {
+                    _impl::_write_color(gbuffer.color,
+                                        width,
+                                        height,
+                                        packet.x[i],
+                                        packet.y[i],
+                                        colors[i],
+                                        true);
+                }
+            }
+        });
+}
+
+template<typename CameraT>
+void RayTracer::scan(const std::vector<CameraT>& cameras,
+                     int width,
+                     int height,
+                     std::vector<ScanPoint>& points,
+                     const ScanOptions& options)
 {
+    if (options.stride < 1) {
+        throw std::invalid_argument("Scan stride must be positive.");
+    }
+    commit();
+
     RTCIntersectContext context;
     rtcInitIntersectContext(&context);
-    auto positions = reinterpret_cast<float*>(
-        rtcGetGeometryBufferData(_geometry, RTC_BUFFER_TYPE_VERTEX, 0));
-    auto indices = reinterpret_cast<unsigned*>(
-        rtcGetGeometryBufferData(_geometry, RTC_BUFFER_TYPE_INDEX, 0));
-#pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            auto u = static_cast<float>(x) / width;
-            auto v = static_cast<float>(y) / height;
-            auto rayhit = camera.gen_ray(u, v);
-            rtcIntersect1(_scene, &context, &rayhit);
-            if (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID) {
-                auto v0 = indices[3 * rayhit.hit.primID];
-                auto v1 = indices[3 * rayhit.hit.primID + 1];
-                auto v2 = indices[3 * rayhit.hit.primID + 2];
-                Eigen::Vector3f p0(positions[3 * v0 + 0],
-                                   positions[3 * v0 + 1],
-                                   positions[3 * v0 + 2]);
-                Eigen::Vector3f p1(positions[3 * v1 + 0],
-                                   positions[3 * v1 + 1],
-                                   positions[3 * v1 + 2]);
-                Eigen::Vector3f p2(positions[3 * v2 + 0],
-                                   positions[3 * v2 + 1],
-                                   positions[3 * v2 + 2]);
-                Eigen::Vector3f p = p1 * rayhit.hit.u + p2 * rayhit.hit.v +
-                                    p0 * (1.0f - rayhit.hit.u - rayhit.hit.v);
-                auto depth = (p - camera.pos).norm();
-                if (tone_mapped) {
-                    auto value = depth / (depth + 1.0);
-                    pixels[(height - y - 1) * width + x] =
-                        static_cast<T>(value * 255);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+    const int views = static_cast<int>(cameras.size());
+    const int tiles_x = (width + _impl::_tile_size - 1) / _impl::_tile_size;
+    const int tiles_y = (height + _impl::_tile_size - 1) / _impl::_tile_size;
+    const int tiles = tiles_x * tiles_y;
+    const auto min_cos =
+        std::cos(options.max_incidence * static_cast<float>(M_PI) / 180.0f);
+
+    std::vector<_impl::_CameraRays> camera_rays;
+    camera_rays.reserve(views);
+    for (const Camera& camera : cameras) {
+        camera_rays.push_back(_impl::_camera_rays(camera, width, height));
+    }
+
+    // Points of each tile of each view, merged in order afterwards
+    std::vector<std::vector<ScanPoint>> buckets(views * tiles);
+    _impl::_for_each_packet(
+        *_scheduler,
+        views,
+        width,
+        height,
+        [&](int view, const _impl::_Packet& packet) {
+            _impl::_Packet subset = packet;
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                if (packet.x[i] % options.stride != 0 ||
+                    packet.y[i] % options.stride != 0) {
+                    subset.valid[i] = 0;
+                }
+            }
+            RTCRayHit8 rayhits;
+            std::visit([&](const auto& rays) { rays(packet, rayhits); },
+                       camera_rays[view]);
+            rtcIntersect8(subset.valid, _scene, &context, &rayhits);
+
+            const int tile = packet.y[0] / _impl::_tile_size * tiles_x +
+                             packet.x[0] / _impl::_tile_size;
+            auto& bucket = buckets[view * tiles + tile];
+            // The seed and the view are hashed together, a plain sum would
+            // give view v + 1 of a seed the noise of view v of the next one
+            const auto view_seed = _impl::_pcg_hash(
+                _impl::_pcg_hash(options.seed) + static_cast<uint32_t>(view));
+            for (int i = 0; i < _impl::_packet_size; ++i) {
+                if (subset.valid[i] == 0 ||
+                    rayhits.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+                    continue;
+                }
+                Eigen::Vector3f org(rayhits.ray.org_x[i],
+                                    rayhits.ray.org_y[i],
+                                    rayhits.ray.org_z[i]);
+                Eigen::Vector3f dir(rayhits.ray.dir_x[i],
+                                    rayhits.ray.dir_y[i],
+                                    rayhits.ray.dir_z[i]);
+                const auto length = dir.norm();
+                dir /= length;
+                Eigen::Vector3f normal = _hit_normal(rayhits, i);
+                auto cos_incidence = normal.dot(dir);
+                if (cos_incidence > 0.0f) {
+                    normal = -normal;
                 }
                 else {
-                    pixels[(height - y - 1) * width + x] =
-                        static_cast<T>(depth);
+                    cos_incidence = -cos_incidence;
+                }
+                if (cos_incidence < min_cos) { continue; }
+
+                // Random numbers of the point
+                const auto stream = static_cast<uint32_t>(
+                    packet.y[i] * width + packet.x[i]);
+                auto random = [&](uint32_t k) {
+                    return _impl::_to_unit_float(
+                        _impl::_pcg_hash(view_seed, stream, k));
+                };
+                if (options.dropout > 0.0f && random(0) < options.dropout) {
+                    continue;
+                }
+
+                auto depth = rayhits.ray.tfar[i] * length;
+                const auto sigma =
+                    options.depth_noise + options.relative_noise * depth;
+                if (sigma > 0.0f) {
+                    depth += sigma * _impl::_gaussian(random(1), random(2));
                 }
+                if (options.normal_noise > 0.0f) {
+                    Eigen::Vector3f noise(
+                        _impl::_gaussian(random(3), random(4)),
+                        _impl::_gaussian(random(5), random(6)),
+                        _impl::_gaussian(random(7), random(8)));
+                    normal = (normal + options.normal_noise * noise)
+                                 .normalized();
+                }
+
+                ScanPoint point;
+                point.position = org + depth * dir;
+                point.normal = normal;
+                point.view = static_cast<unsigned>(view);
+                point.primitive = rayhits.hit.primID[i];
+                point.geometry = _hit_id(rayhits, i);
+                bucket.push_back(point);
             }
+        });
+
+    std::vector<size_t> offsets(buckets.size() + 1, 0);
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        offsets[i + 1] = offsets[i] + buckets[i].size();
+    }
+    points.resize(offsets.back());
+    _scheduler->run(static_cast<int>(buckets.size()), [&](int i) {
+        std::copy(
+            buckets[i].begin(), buckets[i].end(), points.begin() + offsets[i]);
+    });
+}
+
+template<typename Rays>
+void RayTracer::_trace_shaded(const _impl::_Packet& packet,
+                              Eigen::Array3f* colors,
+                              const Rays& rays,
+                              int width,
+                              int samples,
+                              unsigned seed) const
+{
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+    float rcpr_samples = 1.0f / samples;
+
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        colors[i].setZero();
+    }
+    for (int s = 0; s < samples; ++s) {
+        float xs[_impl::_packet_size];
+        float ys[_impl::_packet_size];
+        for (int i = 0; i < _impl::_packet_size; ++i) {
+            // Each pixel has its own sample stream
+            float ds, dt;
+            _impl::_stratified_sample(seed,
+                                      packet.y[i] * width + packet.x[i],
+                                      s,
+                                      samples,
+                                      ds,
+                                      dt);
+            xs[i] = packet.x[i] + ds;
+            ys[i] = packet.y[i] + dt;
         }
+        RTCRayHit8 rayhits;
+        rays(xs, ys, rayhits);
+        rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+        for (int i = 0; i < _impl::_packet_size; ++i) {
+            if (packet.valid[i] == 0 ||
+                rayhits.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+                continue;
+            }
+            colors[i] += _shade(rayhits, i);
+        }
+    }
+
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        colors[i] *= rcpr_samples;
     }
 }
 
-template<typename T>
-void RayTracer::render_silhouette(T* pixels,
-                                  const Camera& camera,
+template<typename Rays, typename T>
+void RayTracer::_trace_depth(const _impl::_Packet& packet,
+                             T* pixels,
+                             const Rays& rays,
+                             int width,
+                             int height,
+                             bool tone_mapped) const
+{
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCRayHit8 rayhits;
+    rays(packet, rayhits);
+    rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        if (packet.valid[i] == 0 ||
+            rayhits.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+            continue;
+        }
+        // The hit distance is in units of the ray direction length
+        Eigen::Vector3f dir(
+            rayhits.ray.dir_x[i], rayhits.ray.dir_y[i], rayhits.ray.dir_z[i]);
+        auto depth = rayhits.ray.tfar[i] * dir.norm();
+        auto idx = (height - packet.y[i] - 1) * width + packet.x[i];
+        if (tone_mapped) {
+            auto value = depth / (depth + 1.0);
+            pixels[idx] = static_cast<T>(value * 255);
+        }
+        else {
+            pixels[idx] = static_cast<T>(depth);
+        }
+    }
+}
+
+template<typename Rays, typename T>
+void RayTracer::_trace_silhouette(const _impl::_Packet& packet,
+                                  T* pixels,
+                                  const Rays& rays,
                                   int width,
-                                  int height)
+                                  int height) const
 {
     RTCIntersectContext context;
     rtcInitIntersectContext(&context);
-#pragma omp parallel for schedule(dynamic)
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            auto u = static_cast<float>(x) / width;
-            auto v = static_cast<float>(y) / height;
-            auto rayhit = camera.gen_ray(u, v);
-            rtcOccluded1(_scene, &context, &(rayhit.ray));
-            if (rayhit.ray.tfar <= 0.0f) {
-                pixels[(height - y - 1) * width + x] = static_cast<T>(255);
-            }
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCRayHit8 rayhits;
+    rays(packet, rayhits);
+    rtcOccluded8(packet.valid, _scene, &context, &rayhits.ray);
+
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        if (packet.valid[i] != 0 && rayhits.ray.tfar[i] <= 0.0f) {
+            pixels[(height - packet.y[i] - 1) * width + packet.x[i]] =
+                static_cast<T>(255);
+        }
+    }
+}
+
+template<typename Rays, typename T>
+void RayTracer::_trace_face_id(const _impl::_Packet& packet,
+                               T* pixels,
+                               const Rays& rays,
+                               int width,
+                               int height) const
+{
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCRayHit8 rayhits;
+    rays(packet, rayhits);
+    rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        if (packet.valid[i] == 0) { continue; }
+        pixels[(height - packet.y[i] - 1) * width + packet.x[i]] =
+            static_cast<T>(rayhits.hit.geomID[i] != RTC_INVALID_GEOMETRY_ID
+                               ? rayhits.hit.primID[i]
+                               : RTC_INVALID_GEOMETRY_ID);
+    }
+}
+
+template<typename Rays, typename T>
+void RayTracer::_trace_attribute(const _impl::_Packet& packet,
+                                 T* pixels,
+                                 const Rays& rays,
+                                 int width,
+                                 int height,
+                                 const ColorMap& colormap,
+                                 float min,
+                                 float max,
+                                 bool shaded,
+                                 bool interleaved) const
+{
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    RTCRayHit8 rayhits;
+    rays(packet, rayhits);
+    rtcIntersect8(packet.valid, _scene, &context, &rayhits);
+
+    // Interpolate the lanes hitting the same geometry together, a packet
+    // usually covers only one or two geometries
+    float values[3 * _impl::_packet_size];
+    bool interpolated[_impl::_packet_size] = {};
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        const auto id = rayhits.hit.geomID[i];
+        if (packet.valid[i] == 0 || id == RTC_INVALID_GEOMETRY_ID ||
+            interpolated[i] ||
+            rayhits.hit.instID[0][i] != RTC_INVALID_GEOMETRY_ID ||
+            _objects[id].attribute_channels == 0) {
+            continue;
+        }
+        int valid[_impl::_packet_size];
+        for (int j = 0; j < _impl::_packet_size; ++j) {
+            const bool same = j >= i && packet.valid[j] != 0 &&
+                              rayhits.hit.geomID[j] == id &&
+                              rayhits.hit.instID[0][j] ==
+                                  RTC_INVALID_GEOMETRY_ID;
+            valid[j] = same ? -1 : 0;
+            interpolated[j] = interpolated[j] || same;
+        }
+
+        RTCInterpolateNArguments args;
+        args.geometry = rtcGetGeometry(_scene, id);
+        args.valid = valid;
+        args.primIDs = rayhits.hit.primID;
+        args.u = rayhits.hit.u;
+        args.v = rayhits.hit.v;
+        args.N = _impl::_packet_size;
+        args.bufferType = RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE;
+        args.bufferSlot = 0;
+        args.P = values;
+        args.dPdu = nullptr;
+        args.dPdv = nullptr;
+        args.ddPdudu = nullptr;
+        args.ddPdvdv = nullptr;
+        args.ddPdudv = nullptr;
+        args.valueCount = _objects[id].attribute_channels;
+        rtcInterpolateN(&args);
+    }
+
+    const float scale = 1.0f / (max - min);
+    for (int i = 0; i < _impl::_packet_size; ++i) {
+        if (packet.valid[i] == 0) { continue; }
+        if (rayhits.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) {
+            _impl::_write_color(pixels,
+                                width,
+                                height,
+                                packet.x[i],
+                                packet.y[i],
+                                Eigen::Array3f::Zero(),
+                                interleaved);
+            continue;
+        }
+        if (!interpolated[i]) {
+            _impl::_write_color(pixels,
+                                width,
+                                height,
+                                packet.x[i],
+                                packet.y[i],
+                                _shade(rayhits, i),
+                                interleaved);
+            continue;
+        }
+
+        // Values are stored channel by channel
+        Eigen::Array3f color;
+        if (_objects[rayhits.hit.geomID[i]].attribute_channels == 1) {
+            color = colormap((values[i] - min) * scale);
+        }
+        else {
+            color << values[i], values[_impl::_packet_size + i],
+                values[2 * _impl::_packet_size + i];
         }
+        // Back to linear colors, which are gamma corrected when written
+        color = color.max(0.0f).pow(2.2f);
+        if (shaded) { color *= _shade(rayhits, i); }
+        _impl::_write_color(pixels,
+                            width,
+                            height,
+                            packet.x[i],
+                            packet.y[i],
+                            color,
+                            interleaved);
     }
 }
 
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// Counter based random numbers, each (seed, stream, counter) triple maps to a
+// fixed value, so results do not depend on the order of evaluation.
+// The mixing function is the output permutation of PCG, see
+// Jarzynski M, Olano M. Hash functions for GPU rendering[J].
+// Journal of Computer Graphics Techniques, 2020, 9(3): 21-38.
+inline uint32_t _pcg_hash(uint32_t input)
+{
+    uint32_t state = input * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+inline uint32_t _pcg_hash(uint32_t seed, uint32_t stream, uint32_t counter)
+{
+    return _pcg_hash(_pcg_hash(_pcg_hash(seed) + stream) + counter);
+}
+
+// Map 32 random bits to a float in [0, 1)
+inline float _to_unit_float(uint32_t bits)
+{
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Van der Corput radical inverse in base 2
+inline float _radical_inverse(uint32_t i)
+{
+    i = (i << 16u) | (i >> 16u);
+    i = ((i & 0x55555555u) << 1u) | ((i & 0xAAAAAAAAu) >> 1u);
+    i = ((i & 0x33333333u) << 2u) | ((i & 0xCCCCCCCCu) >> 2u);
+    i = ((i & 0x0F0F0F0Fu) << 4u) | ((i & 0xF0F0F0F0u) >> 4u);
+    i = ((i & 0x00FF00FFu) << 8u) | ((i & 0xFF00FF00u) >> 8u);
+    return _to_unit_float(i);
+}
+
+// Radical inverse in base 3
+inline float _radical_inverse3(uint32_t i)
+{
+    float inverse = 0.0f;
+    float digit = 1.0f / 3.0f;
+    while (i > 0) {
+        inverse += (i % 3) * digit;
+        i /= 3;
+        digit /= 3.0f;
+    }
+    return inverse;
+}
+
+// The k-th sample in [0, 1)^2 of a stream, without knowing the number of
+// samples in advance.
+// The samples form a randomly shifted Halton sequence in base (2, 3), so
+// every prefix of the sequence is well distributed and samples could be added
+// progressively.
+inline void _progressive_sample(uint32_t seed,
+                                uint32_t stream,
+                                uint32_t k,
+                                float& s,
+                                float& t)
+{
+    auto shift_s = _to_unit_float(_pcg_hash(seed, stream, 0));
+    auto shift_t = _to_unit_float(_pcg_hash(seed, stream, 1));
+    s = _radical_inverse(k) + shift_s;
+    t = _radical_inverse3(k) + shift_t;
+    if (s >= 1.0f) { s -= 1.0f; }
+    if (t >= 1.0f) { t -= 1.0f; }
+}
+
+// The k-th of n stratified samples in [0, 1)^2 of a stream.
+// The samples form a Hammersley point set which is randomly shifted per
+// stream (Cranley-Patterson rotation), so neighboring streams decorrelate
+// while each stream keeps its low discrepancy.
+inline void _stratified_sample(uint32_t seed,
+                               uint32_t stream,
+                               uint32_t k,
+                               uint32_t n,
+                               float& s,
+                               float& t)
+{
+    auto shift_s = _to_unit_float(_pcg_hash(seed, stream, 0));
+    auto shift_t = _to_unit_float(_pcg_hash(seed, stream, 1));
+    s = (k + 0.5f) / n + shift_s;
+    t = _radical_inverse(k) + shift_t;
+    if (s >= 1.0f) { s -= 1.0f; }
+    if (t >= 1.0f) { t -= 1.0f; }
+}
+
+// Map a sample in [0, 1)^2 to a standard normal random number, using the
+// Box-Muller transform
+inline float _gaussian(float s, float t)
+{
+    const float r = std::sqrt(-2.0f * std::log(1.0f - s));
+    return r * std::cos(2.0f * static_cast<float>(M_PI) * t);
+}
+
+// Build an orthonormal basis (b1, b2, n) from a unit vector n, see
+// Duff T, Burgess J, Christensen P, et al. Building an orthonormal basis,
+// revisited[J]. Journal of Computer Graphics Techniques, 2017, 6(1): 1-8.
+inline void _orthonormal_basis(const Eigen::Vector3f& n,
+                               Eigen::Vector3f& b1,
+                               Eigen::Vector3f& b2)
+{
+    const float sign = std::copysign(1.0f, n(2));
+    const float a = -1.0f / (sign + n(2));
+    const float b = n(0) * n(1) * a;
+    b1 << 1.0f + sign * n(0) * n(0) * a, sign * b, -sign * n(0);
+    b2 << b, sign + n(1) * n(1) * a, -n(1);
+}
+
+// Map a sample in [0, 1)^2 to a cosine weighted direction on the hemisphere
+// around the unit vector n
+inline Eigen::Vector3f _cosine_hemisphere(const Eigen::Vector3f& n,
+                                          float s,
+                                          float t)
+{
+    Eigen::Vector3f b1, b2;
+    _orthonormal_basis(n, b1, b2);
+    const float r = std::sqrt(s);
+    const float phi = 2.0f * static_cast<float>(M_PI) * t;
+    const float z = std::sqrt(std::max(0.0f, 1.0f - s));
+    return r * std::cos(phi) * b1 + r * std::sin(phi) * b2 + z * n;
+}
+
+} // namespace _impl
+
+} // namespace Euclid
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <embree3/rtcore.h>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// 64-bit hash of a buffer, following the XXH64 algorithm of xxHash,
+// see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+constexpr uint64_t _xxh_prime1 = 11400714785074694791ULL;
+constexpr uint64_t _xxh_prime2 = 14029467366897019727ULL;
+constexpr uint64_t _xxh_prime3 = 1609587929392839161ULL;
+constexpr uint64_t _xxh_prime4 = 9650029242287828579ULL;
+constexpr uint64_t _xxh_prime5 = 2870177450012600261ULL;
+
+inline uint64_t _rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t _read64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t _read32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t _xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * _xxh_prime2;
+    acc = _rotl64(acc, 31);
+    return acc * _xxh_prime1;
+}
+
+inline uint64_t _xxh64_merge(uint64_t acc, uint64_t value)
+{
+    acc ^= _xxh64_round(0, value);
+    return acc * _xxh_prime1 + _xxh_prime4;
+}
+
+inline uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    const auto end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + _xxh_prime1 + _xxh_prime2;
+        uint64_t v2 = seed + _xxh_prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - _xxh_prime1;
+        const auto limit = end - 32;
+        do {
+            v1 = _xxh64_round(v1, _read64(p));
+            v2 = _xxh64_round(v2, _read64(p + 8));
+            v3 = _xxh64_round(v3, _read64(p + 16));
+            v4 = _xxh64_round(v4, _read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = _rotl64(v1, 1) + _rotl64(v2, 7) + _rotl64(v3, 12) +
+               _rotl64(v4, 18);
+        hash = _xxh64_merge(hash, v1);
+        hash = _xxh64_merge(hash, v2);
+        hash = _xxh64_merge(hash, v3);
+        hash = _xxh64_merge(hash, v4);
+    }
+    else {
+        hash = seed + _xxh_prime5;
+    }
+    hash += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= _xxh64_round(0, _read64(p));
+        hash = _rotl64(hash, 27) * _xxh_prime1 + _xxh_prime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(_read32(p)) * _xxh_prime1;
+        hash = _rotl64(hash, 23) * _xxh_prime2 + _xxh_prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= (*p) * _xxh_prime5;
+        hash = _rotl64(hash, 11) * _xxh_prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= _xxh_prime2;
+    hash ^= hash >> 29;
+    hash *= _xxh_prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Content hash of a geometry
+template<typename FT, typename IT>
+uint64_t _hash_geometry(const std::vector<FT>& positions,
+                        const std::vector<IT>& indices,
+                        RTCGeometryType type)
+{
+    auto hash = xxh64(positions.data(), positions.size() * sizeof(FT), type);
+    return xxh64(indices.data(), indices.size() * sizeof(IT), hash);
+}
+
+// Key of a cached scene. Scenes belong to a device and are built with the
+// flags and the build quality of the ray tracer which added them. The sizes
+// of the buffers are compared on top of the hash, so that a collision of
+// the hash alone does not return another mesh.
+struct _SceneKey
+{
+    RTCDevice device;
+    uint64_t hash;
+    size_t positions;
+    size_t indices;
+    RTCSceneFlags flags;
+    RTCBuildQuality quality;
+
+    bool operator<(const _SceneKey& rhs) const
+    {
+        return std::tie(device, hash, positions, indices, flags, quality) <
+               std::tie(rhs.device,
+                        rhs.hash,
+                        rhs.positions,
+                        rhs.indices,
+                        rhs.flags,
+                        rhs.quality);
+    }
+};
+
+// Process-wide cache of committed scenes, evicting the least recently used
+// scenes when the estimated memory exceeds the budget.
+class _SceneCache
+{
+public:
+    static _SceneCache& instance()
+    {
+        static _SceneCache cache;
+        return cache;
+    }
+
+    ~_SceneCache()
+    {
+        for (auto& entry : _entries) {
+            rtcReleaseScene(entry.scene);
+        }
+    }
+
+    // Estimated memory of a scene of one mesh, the BVH of Embree takes
+    // roughly 128 bytes per primitive
+    static size_t estimate(size_t vertices, size_t faces, size_t face_size)
+    {
+        return vertices * 3 * sizeof(float) +
+               faces * face_size * sizeof(unsigned) + faces * 128;
+    }
+
+    // Return a new reference of the cached scene, or nullptr
+    RTCScene find(const _SceneKey& key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _index.find(key);
+        if (iter == _index.end()) { return nullptr; }
+        _entries.splice(_entries.begin(), _entries, iter->second);
+        rtcRetainScene(iter->second->scene);
+        return iter->second->scene;
+    }
+
+    // Cache a new reference of the scene
+    void insert(const _SceneKey& key, RTCScene scene, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_index.count(key) != 0) { return; }
+        rtcRetainScene(scene);
+        _entries.push_front({ key, scene, bytes });
+        _index[key] = _entries.begin();
+        _bytes += bytes;
+        _evict();
+    }
+
+    void set_budget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _budget = bytes;
+        _evict();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& entry : _entries) {
+            rtcReleaseScene(entry.scene);
+        }
+        _entries.clear();
+        _index.clear();
+        _bytes = 0;
+    }
+
+private:
+    struct _Entry
+    {
+        _SceneKey key;
+        RTCScene scene;
+        size_t bytes;
+    };
+
+    _SceneCache() = default;
+
+    // Scenes still attached to ray tracers stay alive after eviction
+    void _evict()
+    {
+        while (_bytes > _budget && !_entries.empty()) {
+            auto& entry = _entries.back();
+            rtcReleaseScene(entry.scene);
+            _index.erase(entry.key);
+            _bytes -= entry.bytes;
+            _entries.pop_back();
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::list<_Entry> _entries;
+    std::map<_SceneKey, std::list<_Entry>::iterator> _index;
+    size_t _bytes = 0;
+    size_t _budget = size_t(1) << 30;
+};
+
+} // namespace _impl
+
+} // namespace Euclid
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Euclid
+{
+
+namespace _impl
+{
+
+// A pool of threads running parallel loops over work items, e.g. the tiles of
+// images. The items of a loop are split evenly among the threads, and a thread
+// running out of items steals half of the remaining items of another one, so
+// the load stays balanced even if the cost of the items varies a lot.
+// The calling thread works on the items as well. A loop started while the
+// pool is busy, e.g. from several threads at the same time or from inside an
+// item, runs sequentially in the calling thread. If an item throws, the
+// remaining items are dropped and the first exception is rethrown in the
+// calling thread once all threads are done.
+class _TileScheduler
+{
+public:
+    // Set threads to 0 to use number of hardware threads
+    explicit _TileScheduler(int threads = 0)
+    {
+        if (threads <= 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        _ranges.reset(new _Range[threads]);
+        _n_ranges = threads;
+        for (int id = 1; id < threads; ++id) {
+            _workers.emplace_back([this, id] { _work(id); });
+        }
+    }
+
+    ~_TileScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    _TileScheduler(const _TileScheduler&) = delete;
+
+    _TileScheduler& operator=(const _TileScheduler&) = delete;
+
+    // Number of threads working on a loop, including the calling thread
+    int threads() const { return _n_ranges; }
+
+    // Invoke func(item) for item in [0, count), and return when all items are
+    // done or rethrow the first exception of them
+    template<typename Func>
+    void run(int count, Func&& func)
+    {
+        if (count <= 0) { return; }
+        // A nested loop finds the flag set by its own thread, so it never
+        // waits for itself
+        if (_workers.empty() || count == 1 || _busy.exchange(true)) {
+            for (int item = 0; item < count; ++item) {
+                func(item);
+            }
+            return;
+        }
+        struct Release
+        {
+            std::atomic<bool>& busy;
+            ~Release() { busy.store(false); }
+        } release{ _busy };
+
+        std::function<void(int)> job = [&func](int item) { func(item); };
+        for (int id = 0; id < _n_ranges; ++id) {
+            std::lock_guard<std::mutex> lock(_ranges[id].mutex);
+            _ranges[id].begin =
+                static_cast<int>(static_cast<long long>(count) * id /
+                                 _n_ranges);
+            _ranges[id].end =
+                static_cast<int>(static_cast<long long>(count) * (id + 1) /
+                                 _n_ranges);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job = &job;
+            _active = static_cast<int>(_workers.size());
+            ++_generation;
+        }
+        _start.notify_all();
+
+        _process(0);
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finish.wait(lock, [this] { return _active == 0; });
+            _job = nullptr;
+            std::swap(error, _error);
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+private:
+    // Items [begin, end) left to a thread, padded to avoid false sharing
+    struct alignas(64) _Range
+    {
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+    };
+
+    void _work(int id)
+    {
+        unsigned generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&] {
+                    return _stop || _generation != generation;
+                });
+                if (_stop) { return; }
+                generation = _generation;
+            }
+
+            _process(id);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_active == 0) { _finish.notify_one(); }
+        }
+    }
+
+    // An exception must not leave a thread, since a worker would terminate
+    // and the caller would return while the workers still use the job
+    void _process(int id)
+    {
+        int item;
+        do {
+            while (_pop(id, item)) {
+                try {
+                    (*_job)(item);
+                }
+                catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        if (!_error) { _error = std::current_exception(); }
+                    }
+                    _drain();
+                }
+            }
+        } while (_steal(id));
+    }
+
+    // Drop the remaining items of every thread
+    void _drain()
+    {
+        for (int id = 0; id < _n_ranges; ++id) {
+            std::lock_guard<std::mutex> lock(_ranges[id].mutex);
+            _ranges[id].begin = _ranges[id].end;
+        }
+    }
+
+    // Take the next item of a thread's own range
+    bool _pop(int id, int& item)
+    {
+        std::lock_guard<std::mutex> lock(_ranges[id].mutex);
+        if (_ranges[id].begin == _ranges[id].end) { return false; }
+        item = _ranges[id].begin++;
+        return true;
+    }
+
+    // Move the back half of another thread's remaining items to the thread
+    bool _steal(int id)
+    {
+        for (int i = 1; i < _n_ranges; ++i) {
+            auto& victim = _ranges[(id + i) % _n_ranges];
+            int begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                const int remaining = victim.end - victim.begin;
+                if (remaining == 0) { continue; }
+                end = victim.end;
+                begin = end - (remaining + 1) / 2;
+                victim.end = begin;
+            }
+            std::lock_guard<std::mutex> lock(_ranges[id].mutex);
+            _ranges[id].begin = begin;
+            _ranges[id].end = end;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::thread> _workers;
+    std::unique_ptr<_Range[]> _ranges;
+    int _n_ranges;
+
+    // Set while a loop runs
+    std::atomic<bool> _busy{ false };
+
+    // Guards the states below
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _finish;
+    const std::function<void(int)>* _job = nullptr;
+    std::exception_ptr _error;
+    unsigned _generation = 0;
+    int _active = 0;
+    bool _stop = false;
+};
+
+} // namespace _impl
+
+} // namespace Euclid
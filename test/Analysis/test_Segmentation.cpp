@@ -0,0 +1,125 @@
+#include <Euclid/Analysis/Segmentation.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/Surface_mesh.h>
+#include <CGAL/property_map.h>
+#include <Euclid/IO/PlyIO.h>
+#include <Euclid/Geometry/MeshHelpers.h>
+
+#include <config.h>
+
+using Kernel = CGAL::Simple_cartesian<double>;
+using Point_3 = Kernel::Point_3;
+using Vector_3 = Kernel::Vector_3;
+using Mesh = CGAL::Surface_mesh<Point_3>;
+
+// Fraction of the elements with the same class
+static double _agreement(const std::vector<int>& lhs,
+                         const std::vector<int>& rhs)
+{
+    size_t same = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (lhs[i] == rhs[i]) { ++same; }
+    }
+    return static_cast<double>(same) / lhs.size();
+}
+
+// Segment with every solver, the solvers of the same system should agree up
+// to their tolerances
+template<typename Segment>
+static void _check_solvers(int size,
+                           const std::vector<int>& seeds,
+                           Segment segment)
+{
+    std::vector<std::vector<int>> classes;
+    for (auto solver : { Euclid::RandomWalkSolver::sparse_lu,
+                         Euclid::RandomWalkSolver::bicgstab,
+                         Euclid::RandomWalkSolver::ldlt,
+                         Euclid::RandomWalkSolver::conjugate_gradient }) {
+        auto seed_indices = seeds;
+        std::vector<int> classes_of_solver;
+        segment(seed_indices, classes_of_solver, solver);
+        REQUIRE(classes_of_solver.size() == static_cast<size_t>(size));
+        for (auto s : seeds) {
+            REQUIRE(classes_of_solver[s] == s);
+        }
+        for (auto c : classes_of_solver) {
+            REQUIRE(std::find(seeds.begin(), seeds.end(), c) != seeds.end());
+        }
+        classes.push_back(std::move(classes_of_solver));
+    }
+
+    // Original system
+    REQUIRE(_agreement(classes[0], classes[1]) > 0.99);
+    // Symmetric system, whose averaged weights give different segments
+    REQUIRE(_agreement(classes[2], classes[3]) > 0.99);
+
+    // Every seed has a segment besides itself
+    for (const auto& c : classes) {
+        for (auto s : seeds) {
+            REQUIRE(std::count(c.begin(), c.end(), s) > 1);
+        }
+    }
+}
+
+TEST_CASE("Package: Analysis/Segmentation", "[segmentation]")
+{
+    std::vector<double> positions;
+    std::vector<double> normals;
+    std::vector<unsigned> indices;
+    std::string filename(DATA_DIR);
+    filename.append("bunny_vn.ply");
+    Euclid::read_ply<3>(
+        filename, positions, &normals, nullptr, &indices, nullptr);
+
+    SECTION("mesh")
+    {
+        Mesh mesh;
+        Euclid::make_mesh<3>(mesh, positions, indices);
+        const auto n = static_cast<int>(num_faces(mesh));
+        std::vector<int> seeds;
+        for (int i = 0; i < 8; ++i) {
+            seeds.push_back(i * n / 8);
+        }
+        _check_solvers(
+            n, seeds, [&](auto& seed_indices, auto& classes, auto solver) {
+                Euclid::random_walk_segmentation(
+                    mesh, seed_indices, classes, solver);
+            });
+    }
+
+    SECTION("point cloud")
+    {
+        std::vector<Point_3> points;
+        std::vector<Vector_3> point_normals;
+        for (size_t i = 0; i < positions.size(); i += 3) {
+            points.emplace_back(
+                positions[i], positions[i + 1], positions[i + 2]);
+            point_normals.emplace_back(
+                normals[i], normals[i + 1], normals[i + 2]);
+        }
+        const auto n = static_cast<int>(points.size());
+        std::vector<size_t> point_indices(n);
+        std::iota(point_indices.begin(), point_indices.end(), 0);
+        std::vector<int> seeds;
+        for (int i = 0; i < 8; ++i) {
+            seeds.push_back(i * n / 8);
+        }
+        _check_solvers(
+            n, seeds, [&](auto& seed_indices, auto& classes, auto solver) {
+                Euclid::random_walk_segmentation(
+                    point_indices.begin(),
+                    point_indices.end(),
+                    CGAL::make_property_map(points),
+                    CGAL::make_property_map(point_normals),
+                    seed_indices,
+                    classes,
+                    solver);
+            });
+    }
+}
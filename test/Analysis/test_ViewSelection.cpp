@@ -2,6 +2,7 @@
 #include <catch.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <CGAL/Simple_cartesian.h>
 #include <CGAL/Surface_mesh.h>
 #include <Euclid/IO/OffIO.h>
@@ -36,6 +37,22 @@ TEST_CASE("Package: Analysis/ViewSelection", "[viewselection]")
         Euclid::write_off<3>(fout, spositions, sindices);
     }
 
+    SECTION("shared unit view sphere")
+    {
+        auto sphere1 = Euclid::ViewSphere<Mesh>::make_subdiv(mesh, 1.0f, 3);
+        auto sphere2 = Euclid::ViewSphere<Mesh>::make_subdiv(mesh, 2.0f, 3);
+        REQUIRE(num_vertices(sphere1.mesh) == 642);
+        REQUIRE(num_vertices(sphere2.mesh) == 642);
+        REQUIRE(sphere2.radius == Approx(2.0f * sphere1.radius));
+
+        auto vpmap = get(boost::vertex_point, sphere2.mesh);
+        for (const auto& v : vertices(sphere2.mesh)) {
+            auto r =
+                std::sqrt(CGAL::squared_distance(vpmap[v], sphere2.center));
+            REQUIRE(r == Approx(sphere2.radius).epsilon(1e-4));
+        }
+    }
+
     SECTION("random view sphere")
     {
         auto sphere = Euclid::ViewSphere<Mesh>::make_random(mesh, 3.0f, 5000);
@@ -47,6 +64,19 @@ TEST_CASE("Package: Analysis/ViewSelection", "[viewselection]")
         Euclid::write_off<3>(fout, spositions, sindices);
     }
 
+    SECTION("fibonacci view sphere")
+    {
+        auto sphere =
+            Euclid::ViewSphere<Mesh>::make_fibonacci(mesh, 3.0f, 1000);
+        REQUIRE(num_vertices(sphere.mesh) == 1000);
+        std::vector<float> spositions;
+        std::vector<float> sindices;
+        Euclid::extract_mesh<3>(sphere.mesh, spositions, sindices);
+        std::string fout(TMP_DIR);
+        fout.append("view_sphere_fibonacci.off");
+        Euclid::write_off<3>(fout, spositions, sindices);
+    }
+
     SECTION("proxy view selection")
     {
         auto view_sphere = Euclid::ViewSphere<Mesh>::make_subdiv(mesh);
@@ -74,4 +104,89 @@ TEST_CASE("Package: Analysis/ViewSelection", "[viewselection]")
         Euclid::write_ply<3>(
             mesh_out, vpositions, nullptr, nullptr, &vindices, &colors);
     }
+
+    SECTION("visibility view selection")
+    {
+        auto view_sphere = Euclid::ViewSphere<Mesh>::make_subdiv(mesh, 3.0f, 3);
+        std::vector<float> view_scores;
+        Euclid::visibility_view_selection(mesh, view_sphere, view_scores);
+        REQUIRE(view_scores.size() == num_vertices(view_sphere.mesh));
+
+        std::vector<int> views{ 0, 5, 11 };
+        std::vector<float> subset_scores;
+        Euclid::visibility_view_selection(mesh,
+                                          view_sphere,
+                                          views,
+                                          subset_scores,
+                                          Euclid::ViewMeasure::visible_area);
+        REQUIRE(subset_scores.size() == views.size());
+        for (auto score : subset_scores) {
+            REQUIRE(score > 0.0f);
+            REQUIRE(score <= 1.0f);
+        }
+
+        std::vector<float> vpositions;
+        std::vector<unsigned> vindices;
+        Euclid::extract_mesh<3>(view_sphere.mesh, vpositions, vindices);
+        auto [smin, smax] =
+            std::minmax_element(view_scores.begin(), view_scores.end());
+        std::vector<unsigned char> colors;
+        colors.reserve(view_scores.size() * 4);
+        for (const auto& s : view_scores) {
+            auto score = (s - *smin) / (*smax - *smin);
+            float r, g, b;
+            igl::colormap(igl::COLOR_MAP_TYPE_JET, score, r, g, b);
+            colors.push_back(static_cast<unsigned char>(r * 255));
+            colors.push_back(static_cast<unsigned char>(g * 255));
+            colors.push_back(static_cast<unsigned char>(b * 255));
+            colors.push_back(128);
+        }
+        std::string mesh_out(TMP_DIR);
+        mesh_out.append("visibility_view_sphere.ply");
+        Euclid::write_ply<3>(
+            mesh_out, vpositions, nullptr, nullptr, &vindices, &colors);
+    }
+
+    SECTION("best view search")
+    {
+        const float tolerance = 4.0f;
+        auto [viewpoint, score] = Euclid::best_view(
+            mesh, 3.0f, Euclid::ViewMeasure::viewpoint_entropy, tolerance);
+        REQUIRE(score > 0.0f);
+
+        // The search is greedy, so it is only bounded by the coarse level it
+        // starts with, whose views all remain candidates
+        auto coarse_sphere =
+            Euclid::ViewSphere<Mesh>::make_subdiv(mesh, 3.0f, 1);
+        std::vector<float> coarse_scores;
+        Euclid::visibility_view_selection(mesh, coarse_sphere, coarse_scores);
+        auto coarse_best =
+            std::max_element(coarse_scores.begin(), coarse_scores.end());
+        REQUIRE(score >= *coarse_best * (1.0f - 1e-3f));
+
+        // The result is a view of the finest level, i.e. the icosphere whose
+        // spacing is below the tolerance, which is 4 subdivisions for 4
+        // degrees, and should score close to the best view of that level
+        auto view_sphere = Euclid::ViewSphere<Mesh>::make_subdiv(mesh, 3.0f, 4);
+        std::vector<float> view_scores;
+        Euclid::visibility_view_selection(mesh, view_sphere, view_scores);
+        auto best = std::max_element(view_scores.begin(), view_scores.end());
+
+        auto vpmap = get(boost::vertex_point, view_sphere.mesh);
+        auto lhs = viewpoint - view_sphere.center;
+        auto nearest = 0.0f;
+        auto max_cos_angle = -1.0f;
+        for (auto v : vertices(view_sphere.mesh)) {
+            auto rhs = get(vpmap, v) - view_sphere.center;
+            auto cos_angle = lhs * rhs / std::sqrt(lhs.squared_length() *
+                                                   rhs.squared_length());
+            if (cos_angle > max_cos_angle) {
+                max_cos_angle = cos_angle;
+                nearest = view_scores[v];
+            }
+        }
+        auto angle = std::acos(std::clamp(max_cos_angle, -1.0f, 1.0f));
+        REQUIRE(angle * 180.0f / static_cast<float>(M_PI) <= tolerance);
+        REQUIRE(nearest >= 0.95f * *best);
+    }
 }
@@ -0,0 +1,102 @@
+#include <Euclid/Analysis/Visibility.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/property_map/property_map.hpp>
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/Surface_mesh.h>
+#include <Euclid/IO/PlyIO.h>
+#include <Euclid/Geometry/MeshHelpers.h>
+#include <Euclid/Geometry/PrimitiveGenerator.h>
+
+#include <config.h>
+
+using Kernel = CGAL::Simple_cartesian<float>;
+using Vector_3 = Kernel::Vector_3;
+using Mesh = CGAL::Surface_mesh<Kernel::Point_3>;
+using Vertex = Mesh::Vertex_index;
+
+TEST_CASE("Package: Analysis/Visibility", "[visibility]")
+{
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<unsigned> indices;
+    std::string filename(DATA_DIR);
+    filename.append("bunny_vn.ply");
+    Euclid::read_ply<3>(
+        filename, positions, &normals, nullptr, &indices, nullptr);
+    Mesh mesh;
+    Euclid::make_mesh<3>(mesh, positions, indices);
+    std::unordered_map<Vertex, Vector_3> vnmap;
+    for (size_t i = 0; i < normals.size(); i += 3) {
+        vnmap[Vertex(static_cast<uint32_t>(i / 3))] =
+            Vector_3(normals[i], normals[i + 1], normals[i + 2]);
+    }
+
+    SECTION("vertex ambient occlusion")
+    {
+        std::vector<float> occlusion;
+        Euclid::vertex_ambient_occlusion(
+            mesh, boost::make_assoc_property_map(vnmap), occlusion, 64);
+        REQUIRE(occlusion.size() == num_vertices(mesh));
+        for (auto value : occlusion) {
+            REQUIRE(value >= 0.0f);
+            REQUIRE(value <= 1.0f);
+        }
+        REQUIRE(*std::max_element(occlusion.begin(), occlusion.end()) > 0.0f);
+
+        // Same seed, same result
+        std::vector<float> again;
+        Euclid::vertex_ambient_occlusion(
+            mesh, boost::make_assoc_property_map(vnmap), again, 64);
+        REQUIRE(again == occlusion);
+
+        std::vector<float> colors;
+        for (auto value : occlusion) {
+            auto c = (1.0f - value) * 255.0f;
+            colors.push_back(c);
+            colors.push_back(c);
+            colors.push_back(c);
+        }
+        std::string fout(TMP_DIR);
+        fout.append("bunny_ao.ply");
+        Euclid::write_ply<3>(
+            fout, positions, nullptr, nullptr, &indices, &colors);
+    }
+
+    SECTION("face ambient occlusion")
+    {
+        std::vector<float> occlusion;
+        Euclid::face_ambient_occlusion(mesh, occlusion, 32);
+        REQUIRE(occlusion.size() == num_faces(mesh));
+
+        // Nothing occludes a convex shape from outside
+        std::vector<float> spositions;
+        std::vector<unsigned> sindices;
+        Euclid::make_icosphere(spositions, sindices, 3);
+        Mesh sphere;
+        Euclid::make_mesh<3>(sphere, spositions, sindices);
+        Euclid::face_ambient_occlusion(sphere, occlusion, 32);
+        REQUIRE(*std::max_element(occlusion.begin(), occlusion.end()) ==
+                Approx(0.0f));
+    }
+
+    SECTION("shape diameter function")
+    {
+        std::vector<float> sdf;
+        Euclid::shape_diameter_function(mesh, sdf);
+        REQUIRE(sdf.size() == num_faces(mesh));
+        auto valid = std::count_if(
+            sdf.begin(), sdf.end(), [](float value) { return value > 0.0f; });
+        REQUIRE(valid > 0);
+
+        // Smoothing keeps the range of values
+        std::vector<float> smoothed;
+        Euclid::shape_diameter_function(mesh, smoothed, 120.0f, 30, 3);
+        REQUIRE(*std::max_element(smoothed.begin(), smoothed.end()) <=
+                *std::max_element(sdf.begin(), sdf.end()));
+    }
+}
@@ -0,0 +1,137 @@
+#include <catch.hpp>
+#include <Euclid/Geometry/KdTree.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Package: Geometry/KdTree", "[kdtree]")
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    const int n = 2000;
+    std::vector<double> positions(3 * n);
+    for (auto& value : positions) {
+        value = uniform(rng);
+    }
+    std::vector<double> queries(3 * 100);
+    for (auto& value : queries) {
+        value = 1.2 * uniform(rng);
+    }
+
+    // All points sorted by distance, by brute force
+    auto sorted_distances = [&](const double* query) {
+        std::vector<std::pair<double, int>> distances;
+        for (int i = 0; i < n; ++i) {
+            const auto dx = positions[3 * i + 0] - query[0];
+            const auto dy = positions[3 * i + 1] - query[1];
+            const auto dz = positions[3 * i + 2] - query[2];
+            distances.emplace_back(std::sqrt(dx * dx + dy * dy + dz * dz), i);
+        }
+        std::sort(distances.begin(), distances.end());
+        return distances;
+    };
+
+    SECTION("k nearest neighbors")
+    {
+        for (int leaf_size : { 1, 16, 5000 }) {
+            Euclid::KdTree<double> tree(positions, leaf_size);
+            REQUIRE(tree.size() == n);
+            Euclid::KdTree<double>::Context context;
+            std::vector<int> indices;
+            std::vector<double> distances;
+            for (int q = 0; q < 100; ++q) {
+                const auto expected = sorted_distances(&queries[3 * q]);
+                tree.knn(&queries[3 * q], 10, indices, distances, context);
+                REQUIRE(indices.size() == 10);
+                for (int j = 0; j < 10; ++j) {
+                    REQUIRE(indices[j] == expected[j].second);
+                    REQUIRE(distances[j] == Approx(expected[j].first));
+                }
+            }
+        }
+    }
+
+    SECTION("radius neighbors")
+    {
+        const double radius = 0.3;
+        Euclid::KdTree<double> tree(positions);
+        Euclid::KdTree<double>::Context context;
+        std::vector<int> indices;
+        std::vector<double> distances;
+        for (int q = 0; q < 100; ++q) {
+            auto expected = sorted_distances(&queries[3 * q]);
+            expected.erase(
+                std::find_if(expected.begin(),
+                             expected.end(),
+                             [&](const auto& e) { return e.first > radius; }),
+                expected.end());
+            tree.radius(&queries[3 * q], radius, indices, distances, context);
+            REQUIRE(indices.size() == expected.size());
+            for (size_t j = 0; j < expected.size(); ++j) {
+                REQUIRE(indices[j] == expected[j].second);
+            }
+        }
+    }
+
+    SECTION("batch queries")
+    {
+        Euclid::KdTree<double> tree(positions);
+        Euclid::KdTree<double>::Context context;
+        std::vector<int> indices;
+        std::vector<double> distances;
+
+        const int k = 7;
+        std::vector<int> batch_indices(100 * k);
+        std::vector<double> batch_distances(100 * k);
+        tree.batch_knn(queries.data(),
+                       100,
+                       k,
+                       batch_indices.data(),
+                       batch_distances.data());
+        for (int q = 0; q < 100; ++q) {
+            tree.knn(&queries[3 * q], k, indices, distances, context);
+            REQUIRE(std::equal(indices.begin(),
+                               indices.end(),
+                               batch_indices.begin() + q * k));
+        }
+
+        std::vector<int> offsets;
+        tree.batch_radius(
+            queries.data(), 100, 0.25, offsets, batch_indices, batch_distances);
+        REQUIRE(offsets.size() == 101);
+        for (int q = 0; q < 100; ++q) {
+            tree.radius(&queries[3 * q], 0.25, indices, distances, context);
+            REQUIRE(offsets[q + 1] - offsets[q] ==
+                    static_cast<int>(indices.size()));
+            REQUIRE(std::equal(indices.begin(),
+                               indices.end(),
+                               batch_indices.begin() + offsets[q]));
+        }
+    }
+
+    SECTION("small trees")
+    {
+        Euclid::KdTree<double> empty(std::vector<double>{});
+        Euclid::KdTree<double>::Context context;
+        std::vector<int> indices{ 1 };
+        std::vector<double> distances{ 1.0 };
+        empty.knn(queries.data(), 3, indices, distances, context);
+        REQUIRE(indices.empty());
+
+        std::vector<double> two(positions.begin(), positions.begin() + 6);
+        Euclid::KdTree<double> tree(two);
+        std::vector<int> batch_indices(3);
+        std::vector<double> batch_distances(3);
+        tree.batch_knn(
+            queries.data(), 1, 3, batch_indices.data(), batch_distances.data());
+        REQUIRE(batch_indices[2] == -1);
+        REQUIRE(std::isinf(batch_distances[2]));
+
+        REQUIRE_THROWS(Euclid::KdTree<double>(positions, 0));
+        two.pop_back();
+        REQUIRE_THROWS(Euclid::KdTree<double>(two));
+    }
+}
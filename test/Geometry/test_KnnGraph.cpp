@@ -0,0 +1,113 @@
+#include <catch.hpp>
+#include <Euclid/Geometry/KnnGraph.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/property_map.h>
+
+using Kernel = CGAL::Simple_cartesian<double>;
+using Point_3 = typename Kernel::Point_3;
+
+TEST_CASE("Package: Geometry/KnnGraph", "[knngraph]")
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<Point_3> points;
+    for (int i = 0; i < 500; ++i) {
+        points.emplace_back(uniform(rng), uniform(rng), uniform(rng));
+    }
+    const int n = static_cast<int>(points.size());
+    const auto pmap = CGAL::Identity_property_map<Point_3>();
+
+    // Distances to all the other points, by brute force
+    auto sorted_distances = [&](int i) {
+        std::vector<std::pair<double, int>> distances;
+        for (int j = 0; j < n; ++j) {
+            if (j == i) { continue; }
+            distances.emplace_back(
+                std::sqrt(CGAL::squared_distance(points[i], points[j])), j);
+        }
+        std::sort(distances.begin(), distances.end());
+        return distances;
+    };
+    auto has_edge = [](const Euclid::KnnGraph<double>& graph, int i, int j) {
+        auto begin = graph.neighbors.begin() + graph.offsets[i];
+        auto end = graph.neighbors.begin() + graph.offsets[i + 1];
+        return std::find(begin, end, j) != end;
+    };
+
+    SECTION("k nearest neighbors")
+    {
+        const int k = 8;
+        Euclid::KnnGraph<double> graph;
+        Euclid::knn_graph(points.begin(), points.end(), pmap, k, graph);
+        REQUIRE(graph.size() == n);
+        REQUIRE(graph.neighbors.size() == static_cast<size_t>(n * k));
+        for (int i = 0; i < n; ++i) {
+            REQUIRE(graph.offsets[i] == i * k);
+            const auto expected = sorted_distances(i);
+            for (int j = 0; j < k; ++j) {
+                REQUIRE(graph.distances[i * k + j] ==
+                        Approx(expected[j].first));
+                REQUIRE(graph.neighbors[i * k + j] != i);
+            }
+        }
+
+        REQUIRE_THROWS(
+            Euclid::knn_graph(points.begin(), points.end(), pmap, 0, graph));
+    }
+
+    SECTION("symmetric k nearest neighbors")
+    {
+        Euclid::KnnGraph<double> directed;
+        Euclid::KnnGraph<double> graph;
+        Euclid::knn_graph(points.begin(), points.end(), pmap, 6, directed);
+        Euclid::knn_graph(points.begin(), points.end(), pmap, 6, graph, true);
+        size_t edges = 0;
+        for (int i = 0; i < n; ++i) {
+            REQUIRE(graph.degree(i) >= 6);
+            for (int e = graph.offsets[i]; e < graph.offsets[i + 1]; ++e) {
+                const auto j = graph.neighbors[e];
+                REQUIRE(has_edge(graph, j, i));
+                REQUIRE((has_edge(directed, i, j) || has_edge(directed, j, i)));
+                if (e > graph.offsets[i]) {
+                    REQUIRE(graph.distances[e] >= graph.distances[e - 1]);
+                }
+            }
+            edges += graph.degree(i);
+        }
+        REQUIRE(edges == graph.neighbors.size());
+    }
+
+    SECTION("radius neighbors")
+    {
+        const double radius = 0.15;
+        Euclid::KnnGraph<double> graph;
+        Euclid::radius_graph(points.begin(), points.end(), pmap, radius, graph);
+        REQUIRE(graph.size() == n);
+        for (int i = 0; i < n; ++i) {
+            const auto expected = sorted_distances(i);
+            auto count = std::count_if(
+                expected.begin(), expected.end(), [&](const auto& entry) {
+                    return entry.first <= radius;
+                });
+            REQUIRE(graph.degree(i) == count);
+            for (int e = graph.offsets[i]; e < graph.offsets[i + 1]; ++e) {
+                REQUIRE(graph.distances[e] <= radius);
+                REQUIRE(has_edge(graph, graph.neighbors[e], i));
+            }
+        }
+
+        Euclid::KnnGraph<double> capped;
+        Euclid::radius_graph(
+            points.begin(), points.end(), pmap, radius, capped, 4);
+        for (int i = 0; i < n; ++i) {
+            REQUIRE(capped.degree(i) == std::min(graph.degree(i), 4));
+        }
+    }
+}
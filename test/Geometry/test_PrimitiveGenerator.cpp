@@ -1,6 +1,8 @@
 #include <catch.hpp>
 #include <Euclid/Geometry/PrimitiveGenerator.h>
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 
 #include <CGAL/Simple_cartesian.h>
@@ -30,4 +32,31 @@ TEST_CASE("Package: Geometry/PrimitiveGenerator", "[primgen]")
         file.append("subdiv_sphere.off");
         Euclid::write_off<3>(file, positions, indices);
     }
+
+    SECTION("Generate icosphere")
+    {
+        std::vector<float> positions;
+        std::vector<unsigned> indices;
+        Euclid::make_icosphere(positions, indices, 3);
+        REQUIRE(positions.size() == 642 * 3);
+        REQUIRE(indices.size() == 1280 * 3);
+        for (size_t i = 0; i < positions.size(); i += 3) {
+            auto len = std::sqrt(positions[i] * positions[i] +
+                                 positions[i + 1] * positions[i + 1] +
+                                 positions[i + 2] * positions[i + 2]);
+            REQUIRE(len == Approx(1.0f));
+        }
+
+        // Coarser levels are embedded in finer levels
+        std::vector<float> coarse_positions;
+        std::vector<unsigned> coarse_indices;
+        Euclid::make_icosphere(coarse_positions, coarse_indices, 2);
+        REQUIRE(std::equal(coarse_positions.begin(),
+                           coarse_positions.end(),
+                           positions.begin()));
+
+        std::string file(TMP_DIR);
+        file.append("icosphere.off");
+        Euclid::write_off<3>(file, positions, indices);
+    }
 }
@@ -0,0 +1,141 @@
+#include <Euclid/IO/ImageWriter.h>
+#include <catch.hpp>
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <config.h>
+
+namespace fs = std::experimental::filesystem;
+
+// Read the RGB pixels of a 24-bit bmp written by stb_image_write, which stores
+// the rows bottom up in BGR order, into top down interleaved rows
+static std::vector<unsigned char> _read_bmp(const std::string& filename,
+                                            int width,
+                                            int height)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(stream)),
+                                    std::istreambuf_iterator<char>());
+    auto word = [&](size_t offset) {
+        return static_cast<uint32_t>(file[offset]) |
+               static_cast<uint32_t>(file[offset + 1]) << 8 |
+               static_cast<uint32_t>(file[offset + 2]) << 16 |
+               static_cast<uint32_t>(file[offset + 3]) << 24;
+    };
+    REQUIRE(file.size() >= 54);
+    REQUIRE(word(18) == static_cast<uint32_t>(width));
+    REQUIRE(word(22) == static_cast<uint32_t>(height));
+    const size_t data = word(10);
+    const size_t stride = (3 * width + 3) / 4 * 4;
+    REQUIRE(file.size() >= data + stride * height);
+
+    std::vector<unsigned char> pixels(3 * width * height);
+    for (int y = 0; y < height; ++y) {
+        auto row = file.data() + data + (height - y - 1) * stride;
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                pixels[3 * (y * width + x) + c] = row[3 * x + 2 - c];
+            }
+        }
+    }
+    return pixels;
+}
+
+TEST_CASE("Package: IO/ImageWriter", "[imagewriter]")
+{
+    const int width = 64;
+    const int height = 48;
+    std::vector<unsigned char> interleaved(3 * width * height);
+    std::vector<float> planar(3 * width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const auto idx = y * width + x;
+            interleaved[3 * idx + 0] = static_cast<unsigned char>(4 * x);
+            interleaved[3 * idx + 1] = static_cast<unsigned char>(5 * y);
+            interleaved[3 * idx + 2] = 128;
+            planar[idx] = 4.0f * x;
+            planar[width * height + idx] = 5.0f * y;
+            planar[2 * width * height + idx] = x % 2 == 0 ? 300.0f : -20.0f;
+        }
+    }
+
+    SECTION("Class: AsyncImageWriter")
+    {
+        std::vector<std::string> files;
+        Euclid::AsyncImageWriter writer(2, 4);
+        for (int i = 0; i < 8; ++i) {
+            std::string file(TMP_DIR);
+            file.append("async_" + std::to_string(i) + ".png");
+            if (i % 2 == 0) {
+                writer.write(file, interleaved.data(), width, height, 3);
+            }
+            else {
+                writer.write(
+                    file, planar.data(), width, height, 3, false, true);
+            }
+            files.push_back(file);
+            REQUIRE(writer.pending() <= 4 + 2);
+        }
+        writer.wait();
+        REQUIRE(writer.pending() == 0);
+        for (const auto& file : files) {
+            REQUIRE(fs::exists(file));
+            REQUIRE(fs::file_size(file) > 0);
+        }
+
+        std::string jpg(TMP_DIR);
+        jpg.append("async.jpg");
+        writer.try_write(jpg, interleaved.data(), width, height, 3);
+        writer.wait();
+
+        std::string bad_dir(TMP_DIR);
+        bad_dir.append("missing/async.png");
+        writer.write(bad_dir, interleaved.data(), width, height, 3);
+        REQUIRE_THROWS(writer.wait());
+
+        std::string bad_ext(TMP_DIR);
+        bad_ext.append("async.gif");
+        REQUIRE_THROWS(
+            writer.write(bad_ext, interleaved.data(), width, height, 3));
+        REQUIRE_THROWS(
+            writer.write(files[0], interleaved.data(), width, height, 5));
+    }
+
+    SECTION("Pixel conversion")
+    {
+        Euclid::AsyncImageWriter writer;
+        std::string direct(TMP_DIR);
+        direct.append("async_interleaved.bmp");
+        writer.write(direct, interleaved.data(), width, height, 3);
+        std::string converted(TMP_DIR);
+        converted.append("async_planar.bmp");
+        writer.write(converted, planar.data(), width, height, 3, false, true);
+        writer.wait();
+
+        REQUIRE(_read_bmp(direct, width, height) == interleaved);
+
+        // Signed bytes keep their bits, e.g. images rendered into chars
+        std::vector<char> chars(interleaved.begin(), interleaved.end());
+        std::string signed_bytes(TMP_DIR);
+        signed_bytes.append("async_char.bmp");
+        writer.write(signed_bytes, chars.data(), width, height, 3);
+        writer.wait();
+        REQUIRE(_read_bmp(signed_bytes, width, height) == interleaved);
+
+        // Planes are interleaved, rows flipped and values clamped
+        const auto pixels = _read_bmp(converted, width, height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const auto idx = 3 * ((height - y - 1) * width + x);
+                REQUIRE(pixels[idx + 0] == 4 * x);
+                REQUIRE(pixels[idx + 1] == 5 * y);
+                REQUIRE(pixels[idx + 2] == (x % 2 == 0 ? 255 : 0));
+            }
+        }
+    }
+}
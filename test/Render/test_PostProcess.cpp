@@ -0,0 +1,125 @@
+#include <Euclid/Render/PostProcess.h>
+#include <catch.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+TEST_CASE("Package: Render/PostProcess", "[postprocess]")
+{
+    const int width = 64;
+    const int height = 48;
+    // A horizontal ramp of linear colors, brighter rows at the bottom
+    std::vector<float> colors(3 * width * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const auto idx = y * width + x;
+            colors[3 * idx + 0] = static_cast<float>(x) / (width - 1);
+            colors[3 * idx + 1] = static_cast<float>(y) / (height - 1);
+            colors[3 * idx + 2] = 2.0f;
+        }
+    }
+    auto expected = [](float value, float max_value) {
+        value = std::min(std::max(value, 0.0f), 1.0f);
+        return std::pow(value, 1.0f / 2.2f) * max_value;
+    };
+
+    SECTION("gamma correction")
+    {
+        std::vector<unsigned char> pixels(3 * width * height);
+        Euclid::post_process(pixels.data(), colors.data(), width, height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                // Rows are flipped
+                const auto src = 3 * (y * width + x);
+                const auto dst = 3 * ((height - y - 1) * width + x);
+                REQUIRE(std::abs(pixels[dst] -
+                                 expected(colors[src], 255.0f)) <= 0.5f);
+                REQUIRE(std::abs(pixels[dst + 1] -
+                                 expected(colors[src + 1], 255.0f)) <= 0.5f);
+                REQUIRE(pixels[dst + 2] == 255);
+            }
+        }
+    }
+
+    SECTION("16-bit planar")
+    {
+        Euclid::PostProcessOptions options;
+        options.max_value = 65535.0f;
+        options.interleaved = false;
+        options.flip = false;
+        std::vector<unsigned short> pixels(3 * width * height);
+        Euclid::post_process(
+            pixels.data(), colors.data(), width, height, options);
+        const auto plane = width * height;
+        for (int idx = 0; idx < plane; ++idx) {
+            REQUIRE(std::abs(pixels[idx] -
+                             expected(colors[3 * idx], 65535.0f)) <= 1.0f);
+            REQUIRE(std::abs(pixels[plane + idx] -
+                             expected(colors[3 * idx + 1], 65535.0f)) <=
+                    1.0f);
+            REQUIRE(pixels[2 * plane + idx] == 65535);
+        }
+    }
+
+    SECTION("accumulated samples")
+    {
+        std::vector<float> sums(colors);
+        std::vector<int> counts(width * height, 4);
+        for (auto& value : sums) {
+            value *= 4.0f;
+        }
+        counts[0] = 0;
+        std::vector<unsigned char> pixels(3 * width * height);
+        std::vector<unsigned char> averaged(3 * width * height);
+        Euclid::post_process(pixels.data(), colors.data(), width, height);
+        Euclid::post_process(
+            averaged.data(), sums.data(), counts.data(), width, height);
+        const auto first = 3 * (height - 1) * width;
+        REQUIRE(averaged[first + 2] == 0);
+        averaged[first + 2] = pixels[first + 2];
+        REQUIRE(averaged == pixels);
+    }
+
+    SECTION("tone mapping")
+    {
+        Euclid::PostProcessOptions options;
+        options.tone_mapping = Euclid::ToneMapping::reinhard;
+        options.gamma = 1.0f;
+        options.flip = false;
+        std::vector<float> pixels(3 * width * height);
+        Euclid::post_process(
+            pixels.data(), colors.data(), width, height, options);
+        // 2 / (1 + 2)
+        REQUIRE(pixels[2] == Approx(170.0f).epsilon(1e-4));
+
+        options.exposure = 0.5f;
+        Euclid::post_process(
+            pixels.data(), colors.data(), width, height, options);
+        REQUIRE(pixels[2] == Approx(127.5f).epsilon(1e-4));
+
+        options.gamma = 0.0f;
+        REQUIRE_THROWS(Euclid::post_process(
+            pixels.data(), colors.data(), width, height, options));
+    }
+
+    SECTION("non-finite colors")
+    {
+        const auto inf = std::numeric_limits<float>::infinity();
+        const auto nan = std::numeric_limits<float>::quiet_NaN();
+        std::vector<float> special{ inf, -inf, nan, 0.5f, inf, nan };
+        for (auto tone_mapping :
+             { Euclid::ToneMapping::clamp, Euclid::ToneMapping::reinhard }) {
+            Euclid::PostProcessOptions options;
+            options.tone_mapping = tone_mapping;
+            std::vector<unsigned char> pixels(special.size());
+            Euclid::post_process(pixels.data(), special.data(), 2, 1, options);
+            // Infinity is white, negative infinity and NaN are black
+            REQUIRE(pixels[0] == 255);
+            REQUIRE(pixels[1] == 0);
+            REQUIRE(pixels[2] == 0);
+            REQUIRE(pixels[4] == 255);
+            REQUIRE(pixels[5] == 0);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include <Euclid/Render/Rasterizer.h>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <CGAL/Simple_cartesian.h>
+#include <Euclid/IO/OffIO.h>
+#include <Euclid/Analysis/AABB.h>
+#include <Euclid/Math/Vector.h>
+#include <stb_image_write.h>
+
+#include <config.h>
+
+using Kernel = CGAL::Simple_cartesian<float>;
+
+TEST_CASE("Package: Render/Rasterizer", "[rasterizer]")
+{
+    std::string filename(DATA_DIR);
+    filename.append("bunny.off");
+    std::vector<float> positions;
+    std::vector<unsigned> indices;
+    Euclid::read_off<3>(filename, positions, indices);
+
+    Euclid::AABB<Kernel> aabb(positions);
+    auto center = Euclid::cgal_to_eigen<float>(aabb.center());
+    auto view = center + Eigen::Vector3f(
+                             0.0f, 0.5f * aabb.ylen(), 2.0f * aabb.zlen());
+    auto up = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+
+    Euclid::RayTracer raytracer;
+    raytracer.attach_geometry(positions, indices);
+    Euclid::Rasterizer rasterizer;
+    rasterizer.attach_geometry(positions, indices);
+
+    const int width = 800;
+    const int height = 600;
+    Euclid::PerspectiveCamera persp(
+        view, center, up, 60.0f, static_cast<float>(width) / height);
+    Euclid::OrthogonalCamera ortho(
+        view, center, up, 1.5f * aabb.xlen(), 1.5f * aabb.ylen());
+
+    SECTION("silhouette")
+    {
+        std::vector<const Euclid::Camera*> cams{ &persp, &ortho };
+        for (auto cam : cams) {
+            std::vector<unsigned char> expected(width * height, 0);
+            std::vector<unsigned char> pixels(width * height, 0);
+            raytracer.render_silhouette(expected.data(), *cam, width, height);
+            rasterizer.render_silhouette(pixels.data(), *cam, width, height);
+
+            // Pixels on the edges of triangles may differ by rounding
+            auto mismatches = 0;
+            for (size_t i = 0; i < pixels.size(); ++i) {
+                if (pixels[i] != expected[i]) { ++mismatches; }
+            }
+            REQUIRE(mismatches <= width * height / 1000);
+
+            auto covered = std::count(pixels.begin(), pixels.end(), 255);
+            REQUIRE(covered > 0);
+            REQUIRE(rasterizer.projected_area(*cam, width, height) ==
+                    static_cast<size_t>(covered));
+        }
+
+        std::vector<unsigned char> pixels(width * height, 0);
+        rasterizer.render_silhouette(pixels.data(), persp, width, height);
+        std::string outfile(TMP_DIR);
+        outfile.append("bunny_rasterized_silhouette.png");
+        stbi_write_png(outfile.c_str(), width, height, 1, pixels.data(), width);
+    }
+
+    SECTION("depth")
+    {
+        std::vector<float> expected(width * height, 0.0f);
+        std::vector<float> depths(width * height, 0.0f);
+        raytracer.render_depth(expected.data(), persp, width, height, false);
+        rasterizer.render_depth(depths.data(), persp, width, height, false);
+
+        auto mismatches = 0;
+        for (size_t i = 0; i < depths.size(); ++i) {
+            if (std::abs(depths[i] - expected[i]) > 1e-3f * aabb.zlen()) {
+                ++mismatches;
+            }
+        }
+        REQUIRE(mismatches <= width * height / 1000);
+
+        std::vector<unsigned char> pixels(width * height, 0);
+        rasterizer.render_depth(pixels.data(), persp, width, height);
+        std::string outfile(TMP_DIR);
+        outfile.append("bunny_rasterized_depth.png");
+        stbi_write_png(outfile.c_str(), width, height, 1, pixels.data(), width);
+    }
+
+    SECTION("release geometry")
+    {
+        rasterizer.release_geometry();
+        REQUIRE(rasterizer.projected_area(persp, width, height) == 0);
+
+        std::vector<unsigned> invalid(indices.begin(), indices.end() - 1);
+        REQUIRE_THROWS(rasterizer.attach_geometry(positions, invalid));
+    }
+}
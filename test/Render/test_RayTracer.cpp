@@ -1,12 +1,17 @@
 #include <Euclid/Render/RayTracer.h>
 #include <catch.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <string>
+#include <thread>
 
 #include <CGAL/Simple_cartesian.h>
 #include <Euclid/IO/OffIO.h>
 #include <Euclid/Analysis/AABB.h>
 #include <Euclid/Math/Vector.h>
+#include <Euclid/Render/PostProcess.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
@@ -132,6 +137,87 @@ TEST_CASE("Package: Render/RayTracer", "[raytracer]")
                 outfile.c_str(), width, height, 3, pixels.data(), width * 3);
         }
 
+        SECTION("deterministic sampling")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            // Same seed, same image with any number of threads
+            Euclid::RayTracer single(1);
+            single.attach_geometry_shared(positions, indices);
+            std::vector<char> pixels2(pixels.size());
+            raytracer.render_shaded(
+                pixels.data(), cam, width, height, 4, true, 42);
+            single.render_shaded(
+                pixels2.data(), cam, width, height, 4, true, 42);
+            REQUIRE(pixels == pixels2);
+        }
+
+        SECTION("linear colors")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<float> colors(3 * width * height);
+            raytracer.render_linear(colors.data(), cam, width, height, 4);
+            std::vector<char> pixels2(pixels.size());
+            Euclid::post_process(pixels2.data(), colors.data(), width, height);
+            raytracer.render_shaded(pixels.data(), cam, width, height, 4);
+            REQUIRE(pixels == pixels2);
+
+            Euclid::PostProcessOptions options;
+            options.max_value = 65535.0f;
+            options.tone_mapping = Euclid::ToneMapping::reinhard;
+            std::vector<unsigned short> pixels16(3 * width * height);
+            Euclid::post_process(
+                pixels16.data(), colors.data(), width, height, options);
+            REQUIRE(*std::max_element(pixels16.begin(), pixels16.end()) > 0);
+        }
+
+        SECTION("adaptive sampling")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            Euclid::AdaptiveSampling sampling;
+            auto spp = raytracer.render_shaded(
+                pixels.data(), cam, width, height, sampling);
+            REQUIRE(spp >= sampling.min_samples);
+            REQUIRE(spp < sampling.max_samples);
+
+            std::string outfile(TMP_DIR);
+            outfile.append("bunny_adaptive.png");
+            stbi_write_png(
+                outfile.c_str(), width, height, 3, pixels.data(), width * 3);
+
+            // Closer to a converged image than uniform sampling with at
+            // least as many samples
+            std::vector<char> reference(pixels.size());
+            std::vector<char> uniform(pixels.size());
+            raytracer.render_shaded(reference.data(), cam, width, height, 64);
+            raytracer.render_shaded(uniform.data(),
+                                    cam,
+                                    width,
+                                    height,
+                                    static_cast<int>(std::ceil(spp)));
+            auto error = [&](const std::vector<char>& image) {
+                double sum = 0.0;
+                for (size_t i = 0; i < image.size(); ++i) {
+                    sum += std::abs(
+                        static_cast<unsigned char>(image[i]) -
+                        static_cast<unsigned char>(reference[i]));
+                }
+                return sum / image.size();
+            };
+            REQUIRE(error(pixels) < error(uniform));
+
+            sampling.budget = 5.0f;
+            spp = raytracer.render_shaded(
+                pixels.data(), cam, width, height, sampling);
+            REQUIRE(spp <= sampling.budget);
+
+            sampling.min_samples = 1;
+            REQUIRE_THROWS(raytracer.render_shaded(
+                pixels.data(), cam, width, height, sampling));
+        }
+
         SECTION("change material")
         {
             Euclid::PerspectiveCamera cam(
@@ -148,6 +234,40 @@ TEST_CASE("Package: Render/RayTracer", "[raytracer]")
                 outfile.c_str(), width, height, 3, pixels.data(), width * 3);
         }
 
+        SECTION("progressive")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<int> passes;
+            auto samples = raytracer.render_progressive(
+                pixels.data(),
+                cam,
+                width,
+                height,
+                8,
+                std::chrono::milliseconds(60000),
+                true,
+                0,
+                [&passes](int samples) { passes.push_back(samples); });
+            REQUIRE(samples == 8);
+            REQUIRE(passes == std::vector<int>{ 1, 2, 4, 8 });
+
+            std::string outfile(TMP_DIR);
+            outfile.append("bunny_progressive.png");
+            stbi_write_png(
+                outfile.c_str(), width, height, 3, pixels.data(), width * 3);
+
+            // A tiny budget still completes the first pass
+            samples =
+                raytracer.render_progressive(pixels.data(),
+                                             cam,
+                                             width,
+                                             height,
+                                             1 << 20,
+                                             std::chrono::milliseconds(1));
+            REQUIRE(samples >= 1);
+        }
+
         SECTION("depth")
         {
             Euclid::PerspectiveCamera cam(
@@ -171,5 +291,416 @@ TEST_CASE("Package: Render/RayTracer", "[raytracer]")
             stbi_write_png(
                 outfile.c_str(), width, height, 1, pixels.data(), width);
         }
+
+        SECTION("face id")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<unsigned> face_ids(width * height);
+            raytracer.render_face_id(face_ids.data(), cam, width, height);
+
+            auto n_faces = indices.size() / 3;
+            auto covered = 0;
+            for (auto id : face_ids) {
+                if (id != RTC_INVALID_GEOMETRY_ID) {
+                    REQUIRE(id < n_faces);
+                    ++covered;
+                }
+            }
+            REQUIRE(covered > 0);
+        }
+
+        SECTION("vertex attribute")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            const auto n_vertices = positions.size() / 3;
+            std::vector<float> heights(n_vertices);
+            for (size_t i = 0; i < n_vertices; ++i) {
+                heights[i] = positions[3 * i + 1];
+            }
+            raytracer.set_vertex_attribute(0, heights);
+            raytracer.render_attribute(pixels.data(),
+                                       cam,
+                                       width,
+                                       height,
+                                       Euclid::ColorMap::jet(),
+                                       aabb.ymin(),
+                                       aabb.ymax(),
+                                       false);
+
+            std::string outfile(TMP_DIR);
+            outfile.append("bunny_attribute.png");
+            stbi_write_png(
+                outfile.c_str(), width, height, 3, pixels.data(), width * 3);
+
+            // Uncovered pixels are black
+            std::vector<unsigned char> mask(width * height, 0);
+            raytracer.render_silhouette(mask.data(), cam, width, height);
+            for (int i = 0; i < width * height; ++i) {
+                if (mask[i] == 0) {
+                    REQUIRE(pixels[3 * i] == 0);
+                    REQUIRE(pixels[3 * i + 1] == 0);
+                    REQUIRE(pixels[3 * i + 2] == 0);
+                }
+            }
+
+            // Vertex colors
+            std::vector<float> colors(3 * n_vertices, 0.0f);
+            for (size_t i = 0; i < n_vertices; ++i) {
+                colors[3 * i] = 1.0f;
+            }
+            raytracer.set_vertex_attribute(0, colors, 3);
+            raytracer.render_attribute(pixels.data(),
+                                       cam,
+                                       width,
+                                       height,
+                                       Euclid::ColorMap::gray(),
+                                       0.0f,
+                                       1.0f,
+                                       false);
+            for (int i = 0; i < width * height; ++i) {
+                if (mask[i] != 0) {
+                    REQUIRE(static_cast<unsigned char>(pixels[3 * i]) == 255);
+                    REQUIRE(pixels[3 * i + 1] == 0);
+                }
+            }
+
+            REQUIRE_THROWS(raytracer.set_vertex_attribute(0, heights, 3));
+            REQUIRE_THROWS(raytracer.render_attribute(pixels.data(),
+                                                      cam,
+                                                      width,
+                                                      height,
+                                                      Euclid::ColorMap::gray(),
+                                                      1.0f,
+                                                      1.0f));
+        }
+
+        SECTION("gbuffer")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<float> depth(width * height);
+            std::vector<float> linear_depth(width * height);
+            std::vector<float> normal(3 * width * height);
+            std::vector<unsigned> primitive(width * height);
+            std::vector<unsigned char> mask(width * height);
+            std::vector<unsigned char> color(3 * width * height);
+            Euclid::GBuffer gbuffer;
+            gbuffer.depth = depth.data();
+            gbuffer.normal = normal.data();
+            gbuffer.primitive = primitive.data();
+            gbuffer.mask = mask.data();
+            gbuffer.color = color.data();
+            raytracer.render_gbuffer(gbuffer, cam, width, height);
+
+            Euclid::GBuffer linear;
+            linear.depth = linear_depth.data();
+            linear.depth_type = Euclid::DepthType::linear;
+            raytracer.render_gbuffer(linear, cam, width, height);
+
+            std::vector<unsigned char> silhouette(width * height);
+            raytracer.render_silhouette(silhouette.data(), cam, width, height);
+            std::vector<unsigned> face_ids(width * height);
+            raytracer.render_face_id(face_ids.data(), cam, width, height);
+            std::vector<float> depth_ref(width * height);
+            raytracer.render_depth(
+                depth_ref.data(), cam, width, height, false);
+            std::vector<unsigned char> shaded(3 * width * height);
+            raytracer.render_shaded(shaded.data(), cam, width, height, 1);
+            REQUIRE(mask == silhouette);
+            REQUIRE(primitive == face_ids);
+            REQUIRE(color == shaded);
+            for (int i = 0; i < width * height; ++i) {
+                REQUIRE(depth[i] == Approx(depth_ref[i]));
+                REQUIRE(linear_depth[i] <= depth[i] + 1e-5f);
+                if (mask[i] != 0) {
+                    Eigen::Map<Eigen::Vector3f> n(&normal[3 * i]);
+                    REQUIRE(n.norm() == Approx(1.0f));
+                }
+            }
+
+            std::string outfile(TMP_DIR);
+            outfile.append("bunny_gbuffer_color.png");
+            stbi_write_png(
+                outfile.c_str(), width, height, 3, color.data(), width * 3);
+        }
+
+        SECTION("batch views")
+        {
+            std::vector<Euclid::PerspectiveCamera> cams;
+            for (int i = 0; i < 8; ++i) {
+                Eigen::AngleAxisf rotation(0.25f * M_PI * i, up);
+                cams.emplace_back(center + rotation * (view - center),
+                                  center,
+                                  up,
+                                  60.0f,
+                                  static_cast<float>(width) / height);
+            }
+            std::vector<unsigned char> batch(cams.size() * width * height);
+            raytracer.render_views(batch.data(),
+                                   cams,
+                                   width,
+                                   height,
+                                   Euclid::RenderMode::silhouette);
+
+            std::vector<unsigned char> image(width * height);
+            for (size_t i = 0; i < cams.size(); ++i) {
+                std::fill(image.begin(), image.end(), 0);
+                raytracer.render_silhouette(
+                    image.data(), cams[i], width, height);
+                REQUIRE(std::equal(image.begin(),
+                                   image.end(),
+                                   batch.begin() + i * width * height));
+            }
+
+            // Types which would truncate depth or face indices are rejected
+            REQUIRE_THROWS(raytracer.render_views(batch.data(),
+                                                  cams,
+                                                  width,
+                                                  height,
+                                                  Euclid::RenderMode::depth));
+            REQUIRE_THROWS(raytracer.render_views(batch.data(),
+                                                  cams,
+                                                  width,
+                                                  height,
+                                                  Euclid::RenderMode::face_id));
+            std::vector<unsigned> face_ids(cams.size() * width * height);
+            raytracer.render_views(face_ids.data(),
+                                   cams,
+                                   width,
+                                   height,
+                                   Euclid::RenderMode::face_id);
+        }
+
+        SECTION("scan")
+        {
+            std::vector<Euclid::PerspectiveCamera> cams;
+            for (int i = 0; i < 4; ++i) {
+                Eigen::AngleAxisf rotation(0.5f * M_PI * i, up);
+                cams.emplace_back(center + rotation * (view - center),
+                                  center,
+                                  up,
+                                  60.0f,
+                                  static_cast<float>(width) / height);
+            }
+            std::vector<Euclid::ScanPoint> points;
+            raytracer.scan(cams, width, height, points);
+            REQUIRE(!points.empty());
+            REQUIRE(points.front().view == 0);
+            REQUIRE(points.back().view == cams.size() - 1);
+
+            // Every point has been seen by the camera of its view
+            std::vector<unsigned char> silhouette(width * height);
+            raytracer.render_silhouette(
+                silhouette.data(), cams[0], width, height);
+            auto covered =
+                std::count(silhouette.begin(), silhouette.end(), 255);
+            auto first_view = std::count_if(
+                points.begin(), points.end(), [](const Euclid::ScanPoint& p) {
+                    return p.view == 0;
+                });
+            REQUIRE(first_view == covered);
+            for (const auto& point : points) {
+                Eigen::Vector3f to_camera =
+                    (cams[point.view].pos - point.position).normalized();
+                REQUIRE(point.normal.dot(to_camera) >= -1e-4f);
+            }
+
+            // Subsampling and noise do not depend on the number of threads
+            Euclid::ScanOptions options;
+            options.stride = 2;
+            options.depth_noise = 1e-3f * aabb.zlen();
+            options.dropout = 0.2f;
+            Euclid::RayTracer single(1);
+            Euclid::RayTracer multiple(4);
+            single.attach_geometry_shared(positions, indices);
+            multiple.attach_geometry_shared(positions, indices);
+            std::vector<Euclid::ScanPoint> noisy1, noisy2;
+            single.scan(cams, width, height, noisy1, options);
+            multiple.scan(cams, width, height, noisy2, options);
+            REQUIRE(noisy1.size() < points.size() / 4);
+            REQUIRE(noisy1.size() == noisy2.size());
+            for (size_t i = 0; i < noisy1.size(); ++i) {
+                REQUIRE(noisy1[i].position == noisy2[i].position);
+                REQUIRE(noisy1[i].view == noisy2[i].view);
+            }
+        }
+
+        SECTION("derived cameras")
+        {
+            // Derived cameras go through the virtual ray generation
+            struct DerivedCamera : public Euclid::PerspectiveCamera
+            {
+                using Euclid::PerspectiveCamera::PerspectiveCamera;
+            };
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            DerivedCamera derived(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+
+            std::vector<unsigned> expected(width * height);
+            std::vector<unsigned> face_ids(width * height);
+            raytracer.render_face_id(expected.data(), cam, width, height);
+            raytracer.render_face_id(face_ids.data(), derived, width, height);
+            // Rays only differ by rounding, which may flip pixels on edges
+            auto mismatches = 0;
+            for (size_t i = 0; i < expected.size(); ++i) {
+                if (face_ids[i] != expected[i]) { ++mismatches; }
+            }
+            REQUIRE(mismatches <= width * height / 1000);
+        }
+
+        SECTION("concurrent ray tracers")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<unsigned char> expected(width * height);
+            raytracer.render_silhouette(expected.data(), cam, width, height);
+
+            // Ray tracers created by each thread share one device
+            std::vector<std::thread> threads;
+            std::vector<int> matches(4, 0);
+            for (size_t t = 0; t < matches.size(); ++t) {
+                threads.emplace_back([&, t] {
+                    Euclid::RayTracer local;
+                    local.attach_geometry_shared(positions, indices);
+                    std::vector<unsigned char> image(width * height);
+                    local.render_silhouette(image.data(), cam, width, height);
+                    matches[t] = image == expected;
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            REQUIRE(std::count(matches.begin(), matches.end(), 1) ==
+                    static_cast<long>(matches.size()));
+        }
+
+        SECTION("instances")
+        {
+            // Drop the padding required by the shared buffer
+            std::vector<float> vertices(positions.begin(), positions.end() - 1);
+            Euclid::RayTracer scene;
+            auto bunny = scene.add_prototype(vertices, indices);
+
+            Eigen::Affine3f left(Eigen::Translation3f(-0.6f * aabb.xlen(),
+                                                      0.0f,
+                                                      0.0f));
+            Eigen::Affine3f right(Eigen::Translation3f(0.6f * aabb.xlen(),
+                                                       0.0f,
+                                                       0.0f));
+            auto id0 = scene.add_instance(bunny, left);
+            auto id1 = scene.add_instance(bunny, right);
+            REQUIRE(id0 != id1);
+            REQUIRE_THROWS(scene.add_instance(bunny + 1));
+
+            Euclid::Material material;
+            material.ambient << 0.2f, 0.0f, 0.0f;
+            material.diffuse << 0.7f, 0.0f, 0.0f;
+            scene.set_material(id1, material);
+
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            scene.render_shaded(pixels.data(), cam, width, height, 4);
+
+            std::string outfile(TMP_DIR);
+            outfile.append("bunny_instances.png");
+            stbi_write_png(
+                outfile.c_str(), width, height, 3, pixels.data(), width * 3);
+
+            // Moving an instance leaves the prototype BVH untouched
+            scene.set_transform(id1, right.rotate(Eigen::AngleAxisf(
+                                         0.5f, Eigen::Vector3f::UnitY())));
+            scene.release_geometry(id0);
+            std::vector<unsigned> face_ids(width * height);
+            scene.render_face_id(face_ids.data(), cam, width, height);
+            auto covered = 0;
+            for (auto id : face_ids) {
+                if (id != RTC_INVALID_GEOMETRY_ID) { ++covered; }
+            }
+            REQUIRE(covered > 0);
+
+            // Released and unknown IDs are rejected, only instances move
+            REQUIRE_THROWS(scene.set_transform(id0, left));
+            REQUIRE_THROWS(scene.set_material(id0, material));
+            REQUIRE_THROWS(scene.release_geometry(id0));
+            REQUIRE_THROWS(scene.set_material(id1 + 1, material));
+            auto mesh = scene.add_geometry(vertices, indices);
+            REQUIRE_THROWS(scene.set_transform(mesh, left));
+            scene.release_geometry(mesh);
+            REQUIRE_THROWS(scene.update_positions(mesh, vertices));
+        }
+
+        SECTION("scene cache")
+        {
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<unsigned char> expected(width * height);
+            raytracer.render_silhouette(expected.data(), cam, width, height);
+
+            std::vector<float> vertices(positions.begin(), positions.end() - 1);
+            for (int i = 0; i < 2; ++i) {
+                // The second ray tracer reuses the cached scene
+                Euclid::RayTracer scene;
+                scene.add_cached(vertices, indices);
+                std::vector<unsigned char> image(width * height);
+                scene.render_silhouette(image.data(), cam, width, height);
+                REQUIRE(image == expected);
+            }
+
+            // Other flags build another scene, and changing the flags leaves
+            // the cached scenes alone
+            Euclid::RayTracer scene;
+            scene.set_scene_flags(RTC_SCENE_FLAG_DYNAMIC);
+            scene.add_cached(vertices, indices);
+            scene.set_scene_flags(RTC_SCENE_FLAG_ROBUST);
+            std::vector<unsigned char> image(width * height);
+            scene.render_silhouette(image.data(), cam, width, height);
+            REQUIRE(image == expected);
+            Euclid::RayTracer::clear_cache();
+        }
+
+        SECTION("deforming geometry")
+        {
+            std::vector<float> vertices(positions.begin(), positions.end() - 1);
+            Euclid::RayTracer scene;
+            scene.set_scene_flags(RTC_SCENE_FLAG_DYNAMIC);
+            scene.set_build_quality(RTC_BUILD_QUALITY_LOW);
+            auto id = scene.add_geometry(vertices, indices);
+
+            Euclid::PerspectiveCamera cam(
+                view, center, up, 60.0f, static_cast<float>(width) / height);
+            std::vector<unsigned char> before(width * height);
+            scene.render_silhouette(before.data(), cam, width, height);
+
+            // Shrink the mesh towards its center
+            for (size_t i = 0; i < vertices.size(); i += 3) {
+                for (size_t j = 0; j < 3; ++j) {
+                    vertices[i + j] =
+                        center(j) + 0.5f * (vertices[i + j] - center(j));
+                }
+            }
+            scene.update_positions(id, vertices);
+            std::vector<unsigned char> after(width * height);
+            scene.render_silhouette(after.data(), cam, width, height);
+
+            auto count = [](const std::vector<unsigned char>& pixels) {
+                return std::count(pixels.begin(), pixels.end(), 255);
+            };
+            REQUIRE(count(after) > 0);
+            REQUIRE(count(after) < count(before));
+
+            // The single mesh of attach_geometry() is refitted as well
+            Euclid::RayTracer single;
+            single.attach_geometry(vertices, indices);
+            std::vector<unsigned char> refitted(width * height);
+            single.update_positions(0, vertices);
+            single.render_silhouette(refitted.data(), cam, width, height);
+            REQUIRE(refitted == after);
+
+            vertices.pop_back();
+            REQUIRE_THROWS(scene.update_positions(id, vertices));
+        }
     }
 }